@@ -0,0 +1,145 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "BlobTracker.hpp"
+
+#include <math.h>
+#include <limits.h>
+#include <opencv2/imgproc.hpp>
+
+/****************************** Definitions **********************************/
+
+//blobs smaller than this many pixels are noise
+#define BLOB_MIN_AREA 6
+//furthest (pixels) a blob can be from where its track predicted it
+#define BLOB_MATCH_DIST 20
+//frames a track needs before it is trusted
+#define BLOB_MIN_HITS 3
+//frames a track is kept without being seen
+#define BLOB_MAX_MISSES 2
+//how much of a new velocity measurement is used
+#define BLOB_VELOCITY_ALPHA 0.5
+
+/****************************** Implementation *******************************/
+
+BlobTracker::BlobTracker( void )
+{
+	reset();
+}
+
+void BlobTracker::reset( void )
+{
+	blobs.clear();
+	p_nextId = 0;
+}
+
+//Find this frame's blobs and hand each to the closest track (by where the
+//track expected it), start tracks for the rest, and drop tracks that have
+//been missing too long
+void BlobTracker::update( cv::Mat frameObstacles )
+{
+	int num = cv::connectedComponentsWithStats( frameObstacles, p_labels,
+			p_stats, p_centroids, 8, CV_32S );
+
+	std::vector<char> taken( blobs.size(), 0 );
+	std::vector<BLOB_T> found;
+	//label 0 is the background
+	for( int i = 1; i < num; i++ ) {
+		const int *stat = p_stats.ptr<int>( i );
+		if( stat[cv::CC_STAT_AREA] < BLOB_MIN_AREA )
+			continue;
+
+		BLOB_T b;
+		b.box = cv::Rect( stat[cv::CC_STAT_LEFT], stat[cv::CC_STAT_TOP],
+				stat[cv::CC_STAT_WIDTH], stat[cv::CC_STAT_HEIGHT] );
+		b.bottom = cv::Point( b.box.x + b.box.width / 2, b.box.y + b.box.height - 1 );
+		b.area = stat[cv::CC_STAT_AREA];
+		b.velocity = cv::Point2f( 0, 0 );
+		b.hits = 1;
+		b.misses = 0;
+		b.confirmed = false;
+
+		//closest unclaimed track
+		int best = -1;
+		float bestDist = BLOB_MATCH_DIST;
+		for( int t = 0; t < (int)blobs.size(); t++ ) {
+			if( taken[t] )
+				continue;
+			cv::Point2f predicted = cv::Point2f( blobs[t].bottom ) + blobs[t].velocity;
+			float dx = predicted.x - b.bottom.x;
+			float dy = predicted.y - b.bottom.y;
+			float dist = sqrtf( dx * dx + dy * dy );
+			if( dist < bestDist ) {
+				bestDist = dist;
+				best = t;
+			}
+		}
+
+		if( best >= 0 ) {
+			//same blob as last frame
+			const BLOB_T &old = blobs[best];
+			taken[best] = 1;
+			cv::Point2f moved = cv::Point2f( b.bottom - old.bottom );
+			b.id = old.id;
+			b.velocity = old.velocity + ( moved - old.velocity ) * BLOB_VELOCITY_ALPHA;
+			b.hits = old.hits + 1;
+			b.confirmed = old.confirmed || b.hits >= BLOB_MIN_HITS;
+		}
+		else {
+			b.id = p_nextId++;
+		}
+		found.push_back( b );
+	}
+
+	//keep tracks we didn't see for a little while, where we expect them
+	for( int t = 0; t < (int)blobs.size(); t++ ) {
+		if( taken[t] || blobs[t].misses >= BLOB_MAX_MISSES )
+			continue;
+		BLOB_T b = blobs[t];
+		b.misses++;
+		cv::Point shift( (int)b.velocity.x, (int)b.velocity.y );
+		b.bottom += shift;
+		b.box += shift;
+		found.push_back( b );
+	}
+
+	blobs.swap( found );
+}
+
+//Track with this ID, NULL once it has been dropped
+const BLOB_T *BlobTracker::find( int id )
+{
+	for( int i = 0; i < (int)blobs.size(); i++ ) {
+		if( blobs[i].id == id )
+			return &blobs[i];
+	}
+	return NULL;
+}
+
+//Confirmed blob closest to the truck (lowest in the frame), NULL for none
+const BLOB_T *BlobTracker::nearest( void )
+{
+	return nearest_in( INT_MIN, INT_MAX, INT_MIN );
+}
+
+//Closest confirmed blob overlapping columns xMin to xMax that reaches down
+//to row yMin or below, NULL for none
+const BLOB_T *BlobTracker::nearest_in( int xMin, int xMax, int yMin )
+{
+	const BLOB_T *best = NULL;
+	for( int i = 0; i < (int)blobs.size(); i++ ) {
+		const BLOB_T &b = blobs[i];
+		if( !b.confirmed || b.bottom.y < yMin )
+			continue;
+		if( b.box.x + b.box.width - 1 < xMin || b.box.x > xMax )
+			continue;
+		if( best == NULL || b.bottom.y > best->bottom.y )
+			best = &b;
+	}
+	return best;
+}
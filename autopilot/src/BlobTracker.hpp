@@ -0,0 +1,52 @@
+/******************************************************************************
+ * BlobTracker Class - Turns the obstacle mask into a short list of cones
+ *                     (connected blobs) and follows them from frame to frame
+ *                     so each keeps its ID, knows how fast it is moving in
+ *                     the image, and doesn't blink in and out when the mask
+ *                     misses it for a frame.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+/****************************** Definitions **********************************/
+
+/** One tracked obstacle */
+typedef struct BLOB_S {
+	int id;
+	cv::Rect box;           //bounding box in the frame
+	cv::Point bottom;       //center of the lowest row (where it sits on the ground)
+	cv::Point2f velocity;   //pixels per frame the bottom point is moving
+	int area;               //pixels
+	int hits;               //frames it has been seen
+	int misses;             //frames in a row it hasn't been
+	bool confirmed;         //seen enough frames to be trusted
+} BLOB_T;
+
+class BlobTracker {
+	//variables
+public:
+	std::vector<BLOB_T> blobs;  //current tracks, confirmed or not
+
+	//methods
+public:
+	BlobTracker();
+	void reset(void);
+	void update(cv::Mat frameObstacles);
+	const BLOB_T *nearest(void);
+	const BLOB_T *nearest_in(int xMin, int xMax, int yMin);
+	const BLOB_T *find(int id);
+
+	//private variables
+private:
+	int p_nextId;
+	cv::Mat p_labels;
+	cv::Mat p_stats;
+	cv::Mat p_centroids;
+};
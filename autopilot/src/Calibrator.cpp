@@ -0,0 +1,184 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "Calibrator.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+
+/****************************** Definitions **********************************/
+
+//pixels greyer than this in a picked region are background, not the target
+#define CALIB_SAT_FLOOR 60
+//pixels needed before a target's box is changed
+#define CALIB_MIN_PIXELS 200
+//portion of the target's hues the hue range has to cover
+#define CALIB_HUE_COVERAGE 0.90
+//narrowest hue range we'll set
+#define CALIB_MIN_HUE_RANGE 3
+//portion of the target's pixels allowed below the saturation/value minimums
+#define CALIB_LOW_PORTION 0.05
+//auto detect looks this much wider than the current boxes
+#define CALIB_AUTO_HUE_SLACK 2
+#define CALIB_AUTO_SAT_SLACK 40
+#define CALIB_AUTO_VAL_SLACK 30
+
+using std::cout;
+using std::endl;
+using std::min;
+using std::max;
+
+/****************************** Implementation *******************************/
+
+Calibrator::Calibrator( void )
+{
+	reset();
+}
+
+void Calibrator::reset( void )
+{
+	for( int t = 0; t < CALIB_TARGET_NUMS; t++ ) {
+		p_hist[t].hue.assign( 180, 0 );
+		p_hist[t].sat.assign( 256, 0 );
+		p_hist[t].val.assign( 256, 0 );
+		p_hist[t].pixels = 0;
+	}
+}
+
+//Region the user drew around a cone or a piece of tape
+void Calibrator::add_region( cv::Mat frame, cv::Rect region, CALIB_TARGET_T target )
+{
+	region &= cv::Rect( 0, 0, frame.cols, frame.rows );
+	if( region.area() == 0 )
+		return;
+
+	//same conversion as Navigate (hues are for CV_RGB2HSV on BGR frames)
+	cv::Mat hsv;
+	cv::Mat mask;
+	cvtColor( frame( region ), hsv, CV_RGB2HSV );
+	inRange( hsv, cv::Scalar( 0, CALIB_SAT_FLOOR, 0 ), cv::Scalar( 180, 255, 255 ), mask );
+	add_pixels( hsv, mask, target );
+}
+
+//Find cones and tape with boxes a little wider than the current ones, the
+//histograms then pull the boxes in around what is really there
+void Calibrator::add_auto( cv::Mat frame, const NAV_PARAMS_T &params )
+{
+	cv::Mat hsv;
+	cv::Mat mask;
+	cvtColor( frame, hsv, CV_RGB2HSV );
+
+	inRange( hsv, cv::Scalar( params.obstacleHueCenter - CALIB_AUTO_HUE_SLACK * params.obstacleHueRange,
+				max( params.obstacleSatMin - CALIB_AUTO_SAT_SLACK, CALIB_SAT_FLOOR ),
+				max( params.obstacleValMin - CALIB_AUTO_VAL_SLACK, 0 ) ),
+			cv::Scalar( params.obstacleHueCenter + CALIB_AUTO_HUE_SLACK * params.obstacleHueRange,
+				255, 255 ), mask );
+	add_pixels( hsv, mask, CALIB_TARGET_OBSTACLE );
+
+	inRange( hsv, cv::Scalar( params.edgeHueCenter - CALIB_AUTO_HUE_SLACK * params.edgeHueRange,
+				max( params.edgeSatMin - CALIB_AUTO_SAT_SLACK, CALIB_SAT_FLOOR ),
+				max( params.edgeValMin - CALIB_AUTO_VAL_SLACK, 0 ) ),
+			cv::Scalar( params.edgeHueCenter + CALIB_AUTO_HUE_SLACK * params.edgeHueRange,
+				255, 255 ), mask );
+	add_pixels( hsv, mask, CALIB_TARGET_EDGE );
+}
+
+long Calibrator::pixels( CALIB_TARGET_T target )
+{
+	return p_hist[target].pixels;
+}
+
+//Replace the HSV boxes of every target we have enough pixels of. Returns
+//true if anything changed.
+bool Calibrator::apply( NAV_PARAMS_T *params )
+{
+	bool changed = false;
+
+	if( derive( p_hist[CALIB_TARGET_OBSTACLE], &params->obstacleHueCenter,
+				&params->obstacleHueRange, &params->obstacleSatMin, &params->obstacleValMin ) ) {
+		cout << "Obstacles: hue " << params->obstacleHueCenter << " +/- " << params->obstacleHueRange
+			<< ", sat >= " << params->obstacleSatMin << ", val >= " << params->obstacleValMin << endl;
+		changed = true;
+	}
+	else {
+		cout << "Obstacles: not enough pixels, keeping the old box" << endl;
+	}
+
+	if( derive( p_hist[CALIB_TARGET_EDGE], &params->edgeHueCenter,
+				&params->edgeHueRange, &params->edgeSatMin, &params->edgeValMin ) ) {
+		cout << "Edges    : hue " << params->edgeHueCenter << " +/- " << params->edgeHueRange
+			<< ", sat >= " << params->edgeSatMin << ", val >= " << params->edgeValMin << endl;
+		changed = true;
+	}
+	else {
+		cout << "Edges    : not enough pixels, keeping the old box" << endl;
+	}
+
+	return changed;
+}
+
+void Calibrator::add_pixels( cv::Mat hsv, cv::Mat mask, CALIB_TARGET_T target )
+{
+	CALIB_HIST_T &hist = p_hist[target];
+
+	for( int y = 0; y < hsv.rows; y++ ) {
+		const uchar *px = hsv.ptr<uchar>( y );
+		const uchar *m = mask.ptr<uchar>( y );
+		for( int x = 0; x < hsv.cols; x++, px += 3 ) {
+			if( m[x] == 0 )
+				continue;
+			hist.hue[min( (int)px[0], 179 )]++;
+			hist.sat[px[1]]++;
+			hist.val[px[2]]++;
+			hist.pixels++;
+		}
+	}
+}
+
+//Hue center at the histogram peak, range widened until it covers most of
+//the hues, and minimums that only leave out the dimmest few pixels
+bool Calibrator::derive( const CALIB_HIST_T &hist, int *hueCenter, int *hueRange,
+		int *satMin, int *valMin )
+{
+	if( hist.pixels < CALIB_MIN_PIXELS )
+		return false;
+
+	int peak = 0;
+	for( int h = 1; h < 180; h++ )
+		if( hist.hue[h] > hist.hue[peak] )
+			peak = h;
+
+	long covered = hist.hue[peak];
+	int range = 0;
+	while( covered < CALIB_HUE_COVERAGE * hist.pixels && range < 90 ) {
+		range++;
+		if( peak - range >= 0 )
+			covered += hist.hue[peak - range];
+		if( peak + range < 180 )
+			covered += hist.hue[peak + range];
+	}
+
+	*hueCenter = peak;
+	*hueRange = max( range, CALIB_MIN_HUE_RANGE );
+	*satMin = percentile( hist.sat, hist.pixels, CALIB_LOW_PORTION );
+	*valMin = percentile( hist.val, hist.pixels, CALIB_LOW_PORTION );
+	return true;
+}
+
+//Smallest value with at least portion of the pixels at or below it
+int Calibrator::percentile( const std::vector<long> &hist, long total, double portion )
+{
+	long sum = 0;
+	for( int i = 0; i < (int)hist.size(); i++ ) {
+		sum += hist[i];
+		if( sum >= portion * total )
+			return i;
+	}
+	return (int)hist.size() - 1;
+}
@@ -0,0 +1,56 @@
+/******************************************************************************
+ * Calibrator Class - Collects hue, saturation and value histograms of cone
+ *                    and course edge pixels (from regions the user picks or
+ *                    found automatically) and turns them into new HSV boxes
+ *                    for Navigate.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+#include "Navigate.hpp"
+
+/****************************** Definitions **********************************/
+
+/** What a region is of */
+typedef enum CALIB_TARGET_E {
+	CALIB_TARGET_OBSTACLE = 0,
+	CALIB_TARGET_EDGE,
+	CALIB_TARGET_NUMS
+} CALIB_TARGET_T;
+
+/** Histograms for one target */
+typedef struct CALIB_HIST_S {
+	std::vector<long> hue;  //0-179
+	std::vector<long> sat;  //0-255
+	std::vector<long> val;  //0-255
+	long pixels;
+} CALIB_HIST_T;
+
+class Calibrator {
+	//methods
+public:
+	Calibrator();
+	void reset(void);
+	void add_region(cv::Mat frame, cv::Rect region, CALIB_TARGET_T target);
+	void add_auto(cv::Mat frame, const NAV_PARAMS_T &params);
+	long pixels(CALIB_TARGET_T target);
+	bool apply(NAV_PARAMS_T *params);
+
+	//private variables
+private:
+	CALIB_HIST_T p_hist[CALIB_TARGET_NUMS];
+
+	//private methods
+private:
+	void add_pixels(cv::Mat hsv, cv::Mat mask, CALIB_TARGET_T target);
+	bool derive(const CALIB_HIST_T &hist, int *hueCenter, int *hueRange,
+			int *satMin, int *valMin);
+	static int percentile(const std::vector<long> &hist, long total, double portion);
+};
@@ -8,18 +8,80 @@
 
 #include <iostream>
 #include "Camera.hpp"
+#include "FrameBus.hpp"
+#include "Recording.hpp"
+
+#include <opencv2/imgproc.hpp>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
 
 /****************************** Definitions **********************************/
 
+//time to wait for the driver to fill a buffer before giving up on a frame
+#define CAMERA_TIMEOUT_MS 1000
+//time close waits for leased frames to come back
+#define CAMERA_CLOSE_WAIT_MS 500
+
 /****************************** Implementation *******************************/
 
+//ioctl that is retried when a signal interrupts it
+static int camera_ioctl( int fd, unsigned long request, void *arg )
+{
+	int r;
+	do {
+		r = ioctl( fd, request, arg );
+	} while( r == -1 && errno == EINTR );
+	return r;
+}
+
+//Monotonic time in seconds, the clock frame times are on (same as
+//Scheduler::now)
+static double camera_now( void )
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
 Camera::Camera( void )
 {
 	p_opened = false;
+	bufferCount = CAMERA_BUFFERS;
+	captureWidth = CAMERA_WIDTH;
+	captureHeight = CAMERA_HEIGHT;
+	backend = CAMERA_BACKEND_NONE;
+	p_sequence = 0;
+	p_fd = -1;
+	p_width = 0;
+	p_height = 0;
+	p_stride = 0;
+	p_inFlight = 0;
+	leaseFailures = 0;
+	useBus = true;
+	p_bus = NULL;
+	p_recording = NULL;
+	p_playFrame = 0;
+}
+
+Camera::~Camera( void )
+{
+	close();
 }
 
 void Camera::open( void )
 {
+#ifdef CAMERA_USE_RECORDING
+	if( open_recording( CAMERA_USE_RECORDING ) )
+		return;
+#endif
+
 #ifdef CAMERA_USE_FILE
 	//cv::String filename(CAMERA_USE_FILE);
 	p_vCap.open(CAMERA_USE_FILE);
@@ -29,6 +91,28 @@ void Camera::open( void )
 		p_vCap >> frame; 
 	}
 #else
+	//someone else has the camera, share its frames
+	if( useBus ) {
+		p_bus = new FrameBus();
+		if( p_bus->attach( FRAME_BUS_NAME ) ) {
+			std::cout << "Camera: frame bus " << p_bus->width() << "x" << p_bus->height()
+				<< std::endl;
+			backend = CAMERA_BACKEND_BUS;
+			alloc_pool( p_bus->width(), p_bus->height() );
+			p_opened = true;
+			return;
+		}
+		delete p_bus;
+		p_bus = NULL;
+	}
+
+	//straight from the driver if we can
+	if( open_v4l2() ) {
+		backend = CAMERA_BACKEND_V4L2;
+		alloc_pool( p_width, p_height );
+		p_opened = true;
+		return;
+	}
 	p_vCap.open(0);
 #endif
 
@@ -36,23 +120,365 @@ void Camera::open( void )
 
 #ifndef CAMERA_USE_FILE
 		//set resolution
-		p_vCap.set(CV_CAP_PROP_FRAME_WIDTH, 160 );
-		p_vCap.set(CV_CAP_PROP_FRAME_HEIGHT, 90 );
+		p_vCap.set(CV_CAP_PROP_FRAME_WIDTH, captureWidth );
+		p_vCap.set(CV_CAP_PROP_FRAME_HEIGHT, captureHeight );
 #endif
+		backend = CAMERA_BACKEND_VIDEOCAPTURE;
+		alloc_pool( (int)p_vCap.get(CV_CAP_PROP_FRAME_WIDTH),
+				(int)p_vCap.get(CV_CAP_PROP_FRAME_HEIGHT) );
 		p_opened = true;
 	} else {
 		std::cout << "Error: Unable to open camera.\n";
 	}
 }
 
+//Frames still leased out must be released before closing. Waits a little
+//for them (a recorder thread may still be writing one), then stays open
+//rather than free buffers and the bus their leases still point into.
+bool Camera::close( void )
+{
+	for( int waited = 0; p_inFlight > 0 && waited < CAMERA_CLOSE_WAIT_MS; waited++ )
+		usleep( 1000 );
+	if( p_inFlight > 0 ) {
+		std::cout << "Error: Camera closing with " << in_flight() << " frames still leased"
+			<< std::endl;
+		return false;
+	}
+
+	if( backend == CAMERA_BACKEND_V4L2 )
+		close_v4l2();
+	else if( backend == CAMERA_BACKEND_BUS ) {
+		delete p_bus;
+		p_bus = NULL;
+	}
+	else if( backend == CAMERA_BACKEND_RECORDING ) {
+		delete p_recording;
+		p_recording = NULL;
+	}
+	else if( p_vCap.isOpened() )
+		p_vCap.release();
+	backend = CAMERA_BACKEND_NONE;
+	p_opened = false;
+	p_pool.clear();
+	p_poolFree.clear();
+	return true;
+}
+
+//Next frame as BGR, owned by the caller (allocates, the drive loop uses
+//grab instead)
 cv::Mat Camera::get_frame( void )
 {
 	cv::Mat frame;
+	CAMERA_FRAME_T grabbed;
 
-	if( p_opened ) {
-		p_vCap >> frame;
-	}
+	if( grab_bgr( &grabbed ) )
+		grabbed.image.copyTo( frame );
 
 	return frame;
 }
 
+//Next frame without copying it. With V4L2 it's the newest frame the driver
+//has (older ones go straight back), as YUYV over the driver's buffer.
+//VideoCapture frames are read into a pool buffer, frame bus frames are
+//read in place.
+bool Camera::grab( CAMERA_FRAME_T *frame )
+{
+	frame->lease.reset();
+	frame->image.release();
+	if( !p_opened )
+		return false;
+
+	if( backend == CAMERA_BACKEND_RECORDING ) {
+		//mapped until the camera closes, nothing to lease
+		return p_recording->frame( p_playFrame++, frame );
+	}
+
+	if( backend == CAMERA_BACKEND_BUS ) {
+		if( !p_bus->acquire( frame, CAMERA_TIMEOUT_MS ) )
+			return false;
+		//count it with our own leases
+		p_inFlight++;
+		std::shared_ptr<void> busLease = frame->lease;
+		frame->lease = std::shared_ptr<void>( frame->image.data,
+				[this, busLease]( void * ) { p_inFlight--; },
+				LeaseAllocator<char>( &p_leases ) );
+		return true;
+	}
+
+	if( backend == CAMERA_BACKEND_VIDEOCAPTURE ) {
+		int index = lease_pool( frame );
+		if( index < 0 )
+			return false;
+		p_vCap >> p_pool[index];
+		frame->image = p_pool[index];
+		frame->format = CAMERA_FORMAT_BGR;
+		frame->time = camera_now();
+		frame->sequence = p_sequence++;
+		return !frame->image.empty();
+	}
+
+	int index = dequeue( &frame->time, &frame->sequence );
+	if( index < 0 )
+		return false;
+
+	p_inFlight++;
+	frame->image = cv::Mat( p_height, p_width, CV_8UC2, p_bufStart[index], p_stride );
+	frame->format = CAMERA_FORMAT_YUYV;
+	frame->lease = std::shared_ptr<void>( p_bufStart[index],
+			[this, index]( void * ) { requeue( index ); p_inFlight--; },
+			LeaseAllocator<char>( &p_leases ) );
+	return true;
+}
+
+//Next frame as BGR in a pool buffer. YUYV frames are decoded into it and
+//their buffer goes straight back.
+bool Camera::grab_bgr( CAMERA_FRAME_T *frame )
+{
+	frame->lease.reset();
+	frame->image.release();
+
+	CAMERA_FRAME_T raw;
+	if( !grab( &raw ) )
+		return false;
+	if( raw.format == CAMERA_FORMAT_BGR ) {
+		*frame = raw;
+		return true;
+	}
+
+	int index = lease_pool( frame );
+	if( index < 0 )
+		return false;
+	cvtColor( raw.image, p_pool[index], cv::COLOR_YUV2BGR_YUYV );
+	frame->image = p_pool[index];
+	frame->format = CAMERA_FORMAT_BGR;
+	frame->time = raw.time;
+	frame->sequence = raw.sequence;
+	return true;
+}
+
+//Driver and pool buffers currently leased out
+int Camera::in_flight( void )
+{
+	return p_inFlight;
+}
+
+//All our BGR buffers up front, nothing is allocated per frame after this
+void Camera::alloc_pool( int width, int height )
+{
+	std::lock_guard<std::mutex> guard( p_queueLock );
+	p_pool.resize( CAMERA_POOL_SIZE );
+	p_poolFree.assign( CAMERA_POOL_SIZE, 1 );
+	for( int i = 0; i < CAMERA_POOL_SIZE; i++ ) {
+		//(a file may not know its size until the first read)
+		if( width > 0 && height > 0 )
+			p_pool[i].create( height, width, CV_8UC3 );
+	}
+}
+
+//Take a free pool buffer for frame, -1 if every one is leased out. A
+//buffer whose lease is gone but that an image still shares (the caller kept
+//frame.image) isn't free yet, we'd write over it.
+int Camera::lease_pool( CAMERA_FRAME_T *frame )
+{
+	std::lock_guard<std::mutex> guard( p_queueLock );
+	for( int i = 0; i < (int)p_poolFree.size(); i++ ) {
+		if( !p_poolFree[i] )
+			continue;
+		if( p_pool[i].u != NULL && p_pool[i].u->refcount > 1 )
+			continue;
+		p_poolFree[i] = 0;
+		p_inFlight++;
+		frame->lease = std::shared_ptr<void>( &p_poolFree[i],
+				[this, i]( void * ) { release_pool( i ); },
+				LeaseAllocator<char>( &p_leases ) );
+		return i;
+	}
+	leaseFailures++;
+	return -1;
+}
+
+void Camera::release_pool( int index )
+{
+	std::lock_guard<std::mutex> guard( p_queueLock );
+	if( index < (int)p_poolFree.size() )
+		p_poolFree[index] = 1;
+	p_inFlight--;
+}
+
+bool Camera::open_recording( const char *dir )
+{
+	p_recording = new Recording();
+	CAMERA_FRAME_T first;
+	if( !p_recording->open( dir ) || !p_recording->frame( 0, &first ) ) {
+		std::cout << "Error: Unable to play recording " << dir << std::endl;
+		delete p_recording;
+		p_recording = NULL;
+		return false;
+	}
+
+	std::cout << "Camera: recording " << dir << ", " << p_recording->frames() << " frames, "
+		<< p_recording->end_time() - p_recording->start_time() << " s" << std::endl;
+	backend = CAMERA_BACKEND_RECORDING;
+	alloc_pool( first.image.cols, first.image.rows );
+	p_playFrame = 0;
+	p_opened = true;
+	return true;
+}
+
+bool Camera::open_v4l2( void )
+{
+	p_fd = ::open( CAMERA_DEVICE, O_RDWR | O_NONBLOCK );
+	if( p_fd < 0 )
+		return false;
+
+	//has to stream
+	struct v4l2_capability cap;
+	memset( &cap, 0, sizeof(cap) );
+	if( camera_ioctl( p_fd, VIDIOC_QUERYCAP, &cap ) < 0 ||
+			!( cap.capabilities & V4L2_CAP_VIDEO_CAPTURE ) ||
+			!( cap.capabilities & V4L2_CAP_STREAMING ) ) {
+		close_v4l2();
+		return false;
+	}
+
+	//YUYV at our resolution (the driver may pick the closest it has)
+	struct v4l2_format fmt;
+	memset( &fmt, 0, sizeof(fmt) );
+	fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	fmt.fmt.pix.width = captureWidth;
+	fmt.fmt.pix.height = captureHeight;
+	fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+	fmt.fmt.pix.field = V4L2_FIELD_NONE;
+	if( camera_ioctl( p_fd, VIDIOC_S_FMT, &fmt ) < 0 ||
+			fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_YUYV ) {
+		close_v4l2();
+		return false;
+	}
+	p_width = fmt.fmt.pix.width;
+	p_height = fmt.fmt.pix.height;
+	p_stride = fmt.fmt.pix.bytesperline;
+
+	//frame rate (not every driver lets us)
+	struct v4l2_streamparm parm;
+	memset( &parm, 0, sizeof(parm) );
+	parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	parm.parm.capture.timeperframe.numerator = 1;
+	parm.parm.capture.timeperframe.denominator = CAMERA_FPS;
+	camera_ioctl( p_fd, VIDIOC_S_PARM, &parm );
+
+	//driver buffers, mapped into our memory
+	struct v4l2_requestbuffers req;
+	memset( &req, 0, sizeof(req) );
+	req.count = bufferCount;
+	req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	req.memory = V4L2_MEMORY_MMAP;
+	if( camera_ioctl( p_fd, VIDIOC_REQBUFS, &req ) < 0 || req.count < 2 ) {
+		close_v4l2();
+		return false;
+	}
+
+	p_bufStart.assign( req.count, (void *)MAP_FAILED );
+	p_bufLength.assign( req.count, 0 );
+	for( unsigned int i = 0; i < req.count; i++ ) {
+		struct v4l2_buffer buf;
+		memset( &buf, 0, sizeof(buf) );
+		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		buf.index = i;
+		if( camera_ioctl( p_fd, VIDIOC_QUERYBUF, &buf ) < 0 ) {
+			close_v4l2();
+			return false;
+		}
+		p_bufLength[i] = buf.length;
+		p_bufStart[i] = mmap( NULL, buf.length, PROT_READ | PROT_WRITE,
+				MAP_SHARED, p_fd, buf.m.offset );
+		if( p_bufStart[i] == MAP_FAILED ) {
+			close_v4l2();
+			return false;
+		}
+		if( camera_ioctl( p_fd, VIDIOC_QBUF, &buf ) < 0 ) {
+			close_v4l2();
+			return false;
+		}
+	}
+
+	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	if( camera_ioctl( p_fd, VIDIOC_STREAMON, &type ) < 0 ) {
+		close_v4l2();
+		return false;
+	}
+
+	std::cout << "Camera: V4L2 " << p_width << "x" << p_height << " YUYV, "
+		<< req.count << " buffers" << std::endl;
+	return true;
+}
+
+void Camera::close_v4l2( void )
+{
+	if( p_fd < 0 )
+		return;
+
+	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	camera_ioctl( p_fd, VIDIOC_STREAMOFF, &type );
+	for( size_t i = 0; i < p_bufStart.size(); i++ )
+		if( p_bufStart[i] != MAP_FAILED )
+			munmap( p_bufStart[i], p_bufLength[i] );
+	p_bufStart.clear();
+	p_bufLength.clear();
+
+	::close( p_fd );
+	p_fd = -1;
+}
+
+//Newest filled buffer, -1 if none came in time (or all are leased out)
+int Camera::dequeue( double *time, long *sequence )
+{
+	struct pollfd pfd;
+	pfd.fd = p_fd;
+	pfd.events = POLLIN;
+	if( poll( &pfd, 1, CAMERA_TIMEOUT_MS ) <= 0 )
+		return -1;
+
+	int index = -1;
+	std::lock_guard<std::mutex> guard( p_queueLock );
+	while( true ) {
+		struct v4l2_buffer buf;
+		memset( &buf, 0, sizeof(buf) );
+		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		if( camera_ioctl( p_fd, VIDIOC_DQBUF, &buf ) < 0 )
+			break;
+
+		//skip stale frames, the planner wants the latest
+		if( index >= 0 ) {
+			struct v4l2_buffer old;
+			memset( &old, 0, sizeof(old) );
+			old.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			old.memory = V4L2_MEMORY_MMAP;
+			old.index = index;
+			camera_ioctl( p_fd, VIDIOC_QBUF, &old );
+		}
+		index = buf.index;
+		//driver's capture time when it's on our clock, otherwise now
+		if( ( buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK ) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC )
+			*time = (double)buf.timestamp.tv_sec + (double)buf.timestamp.tv_usec * 1e-6;
+		else
+			*time = camera_now();
+		*sequence = buf.sequence;
+	}
+	return index;
+}
+
+void Camera::requeue( int index )
+{
+	std::lock_guard<std::mutex> guard( p_queueLock );
+	if( p_fd < 0 )
+		return;
+
+	struct v4l2_buffer buf;
+	memset( &buf, 0, sizeof(buf) );
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = index;
+	camera_ioctl( p_fd, VIDIOC_QBUF, &buf );
+}
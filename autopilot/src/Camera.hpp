@@ -2,6 +2,18 @@
  * Camera Class - This may source directly from a camera or from a file
  * 		  depending if the CAMERA_USE_FILE definition is set.
  *
+ *                A camera is streamed straight from V4L2 (mmap buffers, no
+ *                copy) when the device can give us YUYV, otherwise it goes
+ *                through cv::VideoCapture like files do. If a capture
+ *                process is already publishing on the frame bus we read
+ *                its frames instead of opening the device.
+ *
+ *                Frames are leased out of buffers allocated when the camera
+ *                opens (the driver's, or our own pool for BGR frames) and
+ *                go back when the last holder lets go. The leases' control
+ *                blocks come from a LeasePool, nothing is allocated per
+ *                frame.
+ *
  * Authors: James Swift, Luke Newmeyer
  * Copyright 2017
  *****************************************************************************/
@@ -11,15 +23,111 @@
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "LeasePool.hpp"
 
 //#define CAMERA_USE_FILE "video_output.avi"
+/** Or play a raw recording (video_capture -r) */
+//#define CAMERA_USE_RECORDING "recording"
+
+/** Capture resolution (Navigate uses pyramid mode above 160x90) */
+#define CAMERA_WIDTH 160
+#define CAMERA_HEIGHT 90
+//#define CAMERA_WIDTH 320
+//#define CAMERA_HEIGHT 240
+//#define CAMERA_WIDTH 640
+//#define CAMERA_HEIGHT 480
+
+/** V4L2 device and its frame rate */
+#define CAMERA_DEVICE "/dev/video0"
+#define CAMERA_FPS 30
+/** Driver buffers: fewer is less latency, more drops fewer frames */
+#define CAMERA_BUFFERS 4
+/** Our own BGR frame buffers (VideoCapture frames, decoded V4L2 frames) */
+#define CAMERA_POOL_SIZE 4
+
+/** Where frames come from */
+typedef enum CAMERA_BACKEND_E {
+	CAMERA_BACKEND_NONE = 0,      //not open
+	CAMERA_BACKEND_V4L2,          //mmap streaming, frames are driver buffers
+	CAMERA_BACKEND_VIDEOCAPTURE,  //cv::VideoCapture (no device, or a file)
+	CAMERA_BACKEND_BUS,           //another process's frames (FrameBus)
+	CAMERA_BACKEND_RECORDING,     //raw recording (Recording)
+	CAMERA_BACKEND_NUMS
+} CAMERA_BACKEND_T;
+
+/** Pixel layout of a grabbed frame */
+typedef enum CAMERA_FORMAT_E {
+	CAMERA_FORMAT_BGR = 0,  //CV_8UC3
+	CAMERA_FORMAT_YUYV,     //CV_8UC2, Y0 U Y1 V
+	CAMERA_FORMAT_NUMS
+} CAMERA_FORMAT_T;
+
+/** A grabbed frame. The image is a driver or pool buffer, it goes back
+ *  when the last copy of lease is gone (drop the image along with it, a
+ *  driver buffer is refilled and a pool buffer isn't reused while an image
+ *  still refers to it). */
+class FrameBus;
+class Recording;
+
+typedef struct CAMERA_FRAME_S {
+	cv::Mat image;
+	CAMERA_FORMAT_T format;
+	double time;           //capture time in seconds (CLOCK_MONOTONIC, as Scheduler::now)
+	long sequence;         //frame count from the driver (or our own)
+	std::shared_ptr<void> lease;
+} CAMERA_FRAME_T;
 
 class Camera {
+public:
+	int bufferCount;       //V4L2 buffers, set before open
+	int captureWidth;      //resolution asked for, set before open
+	int captureHeight;
+	bool useBus;           //read the frame bus when there is one (set before open)
+	CAMERA_BACKEND_T backend;
+
 public:
 	Camera();
+	~Camera();
 	void open();
+	bool close();
 	cv::Mat get_frame();
+	bool grab(CAMERA_FRAME_T *frame);
+	bool grab_bgr(CAMERA_FRAME_T *frame);
+	int in_flight(void);
+	long leaseFailures;    //grabs that found every buffer leased out
 private:
 	bool p_opened;
 	cv::VideoCapture p_vCap;
+	long p_sequence;
+	int p_fd;
+	int p_width;
+	int p_height;
+	int p_stride;
+	std::vector<void *> p_bufStart;
+	std::vector<size_t> p_bufLength;
+	std::mutex p_queueLock;
+	std::vector<cv::Mat> p_pool;
+	std::vector<char> p_poolFree;
+	std::atomic<int> p_inFlight;  //driver and pool buffers leased out
+	LeasePool p_leases;           //control blocks for the leases
+	FrameBus *p_bus;
+	Recording *p_recording;
+	long p_playFrame;     //next frame of the recording
+
+private:
+	Camera(const Camera &);
+	Camera &operator=(const Camera &);
+	bool open_v4l2(void);
+	void close_v4l2(void);
+	bool open_recording(const char *dir);
+	int dequeue(double *time, long *sequence);
+	void requeue(int index);
+	void alloc_pool(int width, int height);
+	int lease_pool(CAMERA_FRAME_T *frame);
+	void release_pool(int index);
 };
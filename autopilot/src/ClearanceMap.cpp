@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "ClearanceMap.hpp"
+
+/****************************** Implementation *******************************/
+
+ClearanceMap::ClearanceMap( void )
+{
+	p_cols = 0;
+	p_rows = 0;
+	p_ready = false;
+}
+
+//One pass left to right and one right to left over every row, carrying the
+//last blocked pixel seen along
+void ClearanceMap::build( cv::Mat frameEdges, cv::Mat frameObstacles )
+{
+	p_cols = frameEdges.cols;
+	p_rows = frameEdges.rows;
+	int total = p_cols * p_rows;
+	p_left.resize( total );
+	p_right.resize( total );
+	p_leftType.resize( total );
+	p_rightType.resize( total );
+
+	for( int y = 0; y < p_rows; y++ ) {
+		const uchar *edgeRow = frameEdges.ptr<uchar>( y );
+		const uchar *obsRow = frameObstacles.ptr<uchar>( y );
+		short *left = &p_left[y * p_cols];
+		short *right = &p_right[y * p_cols];
+		unsigned char *leftType = &p_leftType[y * p_cols];
+		unsigned char *rightType = &p_rightType[y * p_cols];
+
+		//a scan that finds nothing stops at the image border
+		short last = 0;
+		unsigned char lastType = EDGE_TYPE_IMG;
+		for( int x = 0; x < p_cols; x++ ) {
+			if( obsRow[x] != 0 ) {
+				last = (short)x;
+				lastType = EDGE_TYPE_OBJECT;
+			}
+			else if( edgeRow[x] != 0 ) {
+				last = (short)x;
+				lastType = EDGE_TYPE_EDGE;
+			}
+			left[x] = last;
+			leftType[x] = lastType;
+		}
+
+		last = (short)( p_cols - 1 );
+		lastType = EDGE_TYPE_IMG;
+		for( int x = p_cols - 1; x >= 0; x-- ) {
+			if( obsRow[x] != 0 ) {
+				last = (short)x;
+				lastType = EDGE_TYPE_OBJECT;
+			}
+			else if( edgeRow[x] != 0 ) {
+				last = (short)x;
+				lastType = EDGE_TYPE_EDGE;
+			}
+			right[x] = last;
+			rightType[x] = lastType;
+		}
+	}
+
+	p_ready = true;
+}
+
+//Mark the map as out of date (the masks it was built from changed)
+void ClearanceMap::clear( void )
+{
+	p_ready = false;
+}
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * ClearanceMap Class - Row wise distance transform of the edge and obstacle
+ *                      masks. For every pixel it keeps the nearest blocked
+ *                      pixel on each side in the same row and what it is, so
+ *                      finding the gap around a point or checking if the
+ *                      truck fits there is a lookup instead of a scan.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+/****************************** Definitions **********************************/
+
+/** What bounds a gap */
+typedef enum EDGE_TYPE_E {
+	EDGE_TYPE_EDGE = 0,
+	EDGE_TYPE_OBJECT,
+	EDGE_TYPE_IMG
+} EDGE_TYPE_T;
+
+class ClearanceMap {
+	//methods
+public:
+	ClearanceMap();
+	void build(cv::Mat frameEdges, cv::Mat frameObstacles);
+	void clear(void);
+	bool ready(void) { return p_ready; }
+
+	//Gap ends as a scan out from (x, y) would find them: the nearest blocked
+	//pixel on that side, or the image border when there isn't one
+	int left(int x, int y) { return p_left[y * p_cols + x]; }
+	int right(int x, int y) { return p_right[y * p_cols + x]; }
+	EDGE_TYPE_T left_type(int x, int y) { return (EDGE_TYPE_T)p_leftType[y * p_cols + x]; }
+	EDGE_TYPE_T right_type(int x, int y) { return (EDGE_TYPE_T)p_rightType[y * p_cols + x]; }
+	//nothing at (x, y) itself
+	bool is_free(int x, int y) { return p_leftType[y * p_cols + x] == EDGE_TYPE_IMG ||
+			p_left[y * p_cols + x] != x; }
+	//free pixels between the gap ends around (x, y)
+	int gap(int x, int y) { return right(x, y) - left(x, y); }
+	//the truck (width pixels wide at this row) fits through the gap at (x, y)
+	bool fits(int x, int y, int width) { return is_free(x, y) && gap(x, y) >= width; }
+
+	//private variables
+private:
+	int p_cols;
+	int p_rows;
+	bool p_ready;
+	std::vector<short> p_left;
+	std::vector<short> p_right;
+	std::vector<unsigned char> p_leftType;
+	std::vector<unsigned char> p_rightType;
+};
@@ -0,0 +1,131 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "ColorTable.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+/****************************** Definitions **********************************/
+
+//bits kept of each channel (6 bits is a 256KB table)
+#define COLOR_TABLE_BITS 6
+#define COLOR_TABLE_SHIFT (8 - COLOR_TABLE_BITS)
+#define COLOR_TABLE_LEVELS (1 << COLOR_TABLE_BITS)
+#define COLOR_TABLE_SIZE (COLOR_TABLE_LEVELS * COLOR_TABLE_LEVELS * COLOR_TABLE_LEVELS)
+
+#define COLOR_INDEX(b, g, r) ((((b) >> COLOR_TABLE_SHIFT) << (2 * COLOR_TABLE_BITS)) | \
+		(((g) >> COLOR_TABLE_SHIFT) << COLOR_TABLE_BITS) | ((r) >> COLOR_TABLE_SHIFT))
+
+/****************************** Implementation *******************************/
+
+ColorTable::ColorTable( void )
+{
+	p_table.assign( COLOR_TABLE_SIZE, COLOR_FREE );
+	p_yuvTable.assign( COLOR_TABLE_SIZE, COLOR_FREE );
+}
+
+//Run the center colour of every table cell through the same conversion and
+//boxes Navigate uses
+void ColorTable::build( const COLOR_BOX_T &obstacle, const COLOR_BOX_T &edge )
+{
+	//every cell's colour as one long image
+	cv::Mat colors( 1, COLOR_TABLE_SIZE, CV_8UC3 );
+	uchar *px = colors.ptr<uchar>( 0 );
+	int half = ( 1 << COLOR_TABLE_SHIFT ) / 2;
+	for( int b = 0; b < COLOR_TABLE_LEVELS; b++ ) {
+		for( int g = 0; g < COLOR_TABLE_LEVELS; g++ ) {
+			for( int r = 0; r < COLOR_TABLE_LEVELS; r++ ) {
+				*px++ = (uchar)( ( b << COLOR_TABLE_SHIFT ) + half );
+				*px++ = (uchar)( ( g << COLOR_TABLE_SHIFT ) + half );
+				*px++ = (uchar)( ( r << COLOR_TABLE_SHIFT ) + half );
+			}
+		}
+	}
+	fill( colors, 1, obstacle, edge, &p_table );
+
+	//and as YUYV pixel pairs (Y U, Y V), decoded the way the camera's frames
+	//would be so both tables agree
+	cv::Mat yuyv( 1, 2 * COLOR_TABLE_SIZE, CV_8UC2 );
+	px = yuyv.ptr<uchar>( 0 );
+	for( int y = 0; y < COLOR_TABLE_LEVELS; y++ ) {
+		for( int u = 0; u < COLOR_TABLE_LEVELS; u++ ) {
+			for( int v = 0; v < COLOR_TABLE_LEVELS; v++ ) {
+				uchar luma = (uchar)( ( y << COLOR_TABLE_SHIFT ) + half );
+				*px++ = luma;
+				*px++ = (uchar)( ( u << COLOR_TABLE_SHIFT ) + half );
+				*px++ = luma;
+				*px++ = (uchar)( ( v << COLOR_TABLE_SHIFT ) + half );
+			}
+		}
+	}
+	cv::Mat decoded;
+	cv::cvtColor( yuyv, decoded, cv::COLOR_YUV2BGR_YUYV );
+	fill( decoded, 2, obstacle, edge, &p_yuvTable );
+}
+
+//Fill the obstacle and edge masks (which may be views into bigger masks)
+void ColorTable::classify( cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges ) const
+{
+	frameObstacles->create( frame.size(), CV_8UC1 );
+	frameEdges->create( frame.size(), CV_8UC1 );
+	const unsigned char *table = &p_table[0];
+
+	for( int y = 0; y < frame.rows; y++ ) {
+		const uchar *px = frame.ptr<uchar>( y );
+		uchar *obs = frameObstacles->ptr<uchar>( y );
+		uchar *edge = frameEdges->ptr<uchar>( y );
+		for( int x = 0; x < frame.cols; x++, px += 3 ) {
+			unsigned char cls = table[COLOR_INDEX( px[0], px[1], px[2] )];
+			obs[x] = (uchar)-( cls == COLOR_OBSTACLE );
+			edge[x] = (uchar)-( cls == COLOR_EDGE );
+		}
+	}
+}
+
+//Same for a YUYV frame, each pixel pair shares its U and V (frames are an
+//even number of pixels wide)
+void ColorTable::classify_yuyv( cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges ) const
+{
+	frameObstacles->create( frame.size(), CV_8UC1 );
+	frameEdges->create( frame.size(), CV_8UC1 );
+	const unsigned char *table = &p_yuvTable[0];
+
+	for( int y = 0; y < frame.rows; y++ ) {
+		const uchar *px = frame.ptr<uchar>( y );
+		uchar *obs = frameObstacles->ptr<uchar>( y );
+		uchar *edge = frameEdges->ptr<uchar>( y );
+		for( int x = 0; x + 1 < frame.cols; x += 2, px += 4 ) {
+			unsigned char cls0 = table[COLOR_INDEX( px[0], px[1], px[3] )];
+			unsigned char cls1 = table[COLOR_INDEX( px[2], px[1], px[3] )];
+			obs[x] = (uchar)-( cls0 == COLOR_OBSTACLE );
+			edge[x] = (uchar)-( cls0 == COLOR_EDGE );
+			obs[x + 1] = (uchar)-( cls1 == COLOR_OBSTACLE );
+			edge[x + 1] = (uchar)-( cls1 == COLOR_EDGE );
+		}
+	}
+}
+
+//Label every step'th pixel of a row of BGR colours, one table cell each
+void ColorTable::fill( cv::Mat bgr, int step, const COLOR_BOX_T &obstacle,
+		const COLOR_BOX_T &edge, std::vector<unsigned char> *table )
+{
+	cv::Mat hsv;
+	cv::Mat isObstacle;
+	cv::Mat isEdge;
+	cv::cvtColor( bgr, hsv, CV_RGB2HSV );
+	cv::inRange( hsv, cv::Scalar( obstacle.hueMin, obstacle.satMin, obstacle.valMin ),
+			cv::Scalar( obstacle.hueMax, 255, obstacle.valMax ), isObstacle );
+	cv::inRange( hsv, cv::Scalar( edge.hueMin, edge.satMin, edge.valMin ),
+			cv::Scalar( edge.hueMax, 255, edge.valMax ), isEdge );
+
+	//obstacles win where the boxes overlap
+	const uchar *obs = isObstacle.ptr<uchar>( 0 );
+	const uchar *edg = isEdge.ptr<uchar>( 0 );
+	for( int i = 0; i < COLOR_TABLE_SIZE; i++ )
+		(*table)[i] = obs[i * step] ? COLOR_OBSTACLE : ( edg[i * step] ? COLOR_EDGE : COLOR_FREE );
+}
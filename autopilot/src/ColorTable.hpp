@@ -0,0 +1,51 @@
+/******************************************************************************
+ * ColorTable Class - Lookup tables from a (slightly quantized) BGR or YUV
+ *                    colour to free, course edge or obstacle. Built once
+ *                    from the HSV boxes, after that classifying a pixel is
+ *                    one lookup with no colour conversion, even for YUYV
+ *                    frames straight from the camera.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+/****************************** Definitions **********************************/
+
+/** Table entries */
+#define COLOR_FREE 0
+#define COLOR_EDGE 1
+#define COLOR_OBSTACLE 2
+
+/** One HSV box (as used with CV_RGB2HSV on our BGR frames) */
+typedef struct COLOR_BOX_S {
+	int hueMin;
+	int hueMax;
+	int satMin;
+	int valMin;
+	int valMax;
+} COLOR_BOX_T;
+
+class ColorTable {
+	//methods
+public:
+	ColorTable();
+	void build(const COLOR_BOX_T &obstacle, const COLOR_BOX_T &edge);
+	void classify(cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges) const;
+	void classify_yuyv(cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges) const;
+
+	//private variables
+private:
+	std::vector<unsigned char> p_table;     //indexed by B, G, R
+	std::vector<unsigned char> p_yuvTable;  //indexed by Y, U, V
+
+	//private methods
+private:
+	void fill(cv::Mat bgr, int step, const COLOR_BOX_T &obstacle,
+			const COLOR_BOX_T &edge, std::vector<unsigned char> *table);
+};
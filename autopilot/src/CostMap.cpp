@@ -0,0 +1,170 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "CostMap.hpp"
+
+#include <algorithm>
+#include <stdlib.h>
+
+/****************************** Definitions **********************************/
+
+//cost of going through an edge or obstacle pixel
+#define COST_BLOCKED 100000
+//cost per pixel the truck's half width overlaps something
+#define COST_CLEARANCE 20
+//cost of moving one column between rows
+#define COST_TURN 3
+//cost per column the path starts away from the center (where the truck is)
+#define COST_START 5
+//distance used when nothing is found in a row
+#define COST_FAR 1000000
+
+#define CLASS_FREE 0
+#define CLASS_EDGE 1
+#define CLASS_OBSTACLE 2
+
+using std::min;
+using std::max;
+
+/****************************** Implementation *******************************/
+
+CostMap::CostMap( void )
+{
+	p_cols = 0;
+	p_rows = 0;
+	blockedRow = -1;
+	blockedByObstacle = false;
+	obstacleOnRight = false;
+}
+
+//Give each pixel a cost. Pixels closer than half the truck width (minGap) to
+//an edge or obstacle in their row cost more the closer they are.
+void CostMap::build( cv::Mat frameEdges, cv::Mat frameObstacles, const std::vector<int> &minGap )
+{
+	p_cols = frameEdges.cols;
+	p_rows = frameEdges.rows;
+	int total = p_cols * p_rows;
+	p_cost.resize( total );
+	p_class.resize( total );
+	p_nearObstacle.resize( total );
+	p_left.resize( p_cols );
+	p_leftObs.resize( p_cols );
+
+	for( int y = 0; y < p_rows; y++ ) {
+		const uchar *edgeRow = frameEdges.ptr<uchar>( y );
+		const uchar *obsRow = frameObstacles.ptr<uchar>( y );
+		int *cost = &p_cost[y * p_cols];
+		unsigned char *cls = &p_class[y * p_cols];
+		unsigned char *near = &p_nearObstacle[y * p_cols];
+		int half = minGap[y] / 2;
+
+		//label pixels and get distance to the nearest blocked pixel on the left
+		int d = COST_FAR;
+		int dObs = COST_FAR;
+		for( int x = 0; x < p_cols; x++ ) {
+			int obs = ( obsRow[x] != 0 );
+			int blocked = obs | ( edgeRow[x] != 0 );
+			cls[x] = (unsigned char)( obs ? CLASS_OBSTACLE : blocked );
+			d = blocked ? 0 : d + 1;
+			dObs = obs ? 0 : dObs + 1;
+			p_left[x] = d;
+			p_leftObs[x] = dObs;
+		}
+
+		//then on the right, and turn the nearest into a cost
+		d = COST_FAR;
+		dObs = COST_FAR;
+		for( int x = p_cols - 1; x >= 0; x-- ) {
+			int obs = ( cls[x] == CLASS_OBSTACLE );
+			int blocked = ( cls[x] != CLASS_FREE );
+			d = blocked ? 0 : d + 1;
+			dObs = obs ? 0 : dObs + 1;
+
+			int nearest = min( d, p_left[x] );
+			int shortfall = max( 0, half - nearest );
+			cost[x] = blocked ? COST_BLOCKED : shortfall * COST_CLEARANCE;
+
+			//remember if an obstacle is within the truck's half width
+			int nearestObs = min( dObs, p_leftObs[x] );
+			near[x] = (unsigned char)( nearestObs < half ? ( dObs < p_leftObs[x] ? 2 : 1 ) : 0 );
+		}
+	}
+}
+
+//Find the cheapest path from the bottom row to the top. The route is the
+//column of the path in each row starting at the bottom, cut off at the first
+//blocked pixel.
+void CostMap::solve( std::vector<int> *route, std::vector<bool> *objInRow )
+{
+	route->clear();
+	objInRow->clear();
+	blockedRow = -1;
+	blockedByObstacle = false;
+	obstacleOnRight = false;
+	if( p_rows == 0 || p_cols == 0 )
+		return;
+
+	int total = p_cols * p_rows;
+	p_acc.resize( total );
+	p_from.resize( total );
+	int mid = p_cols / 2;
+
+	//bottom row starts under the truck
+	int *acc = &p_acc[( p_rows - 1 ) * p_cols];
+	const int *cost = &p_cost[( p_rows - 1 ) * p_cols];
+	for( int x = 0; x < p_cols; x++ ) {
+		acc[x] = cost[x] + COST_START * abs( x - mid );
+		p_from[( p_rows - 1 ) * p_cols + x] = 0;
+	}
+
+	//each row takes the cheapest of the three pixels below it
+	for( int y = p_rows - 2; y >= 0; y-- ) {
+		const int *below = &p_acc[( y + 1 ) * p_cols];
+		acc = &p_acc[y * p_cols];
+		cost = &p_cost[y * p_cols];
+		signed char *from = &p_from[y * p_cols];
+
+		//image borders only have two neighbours
+		acc[0] = cost[0] + min( below[0], below[1] + COST_TURN );
+		from[0] = (signed char)( below[1] + COST_TURN < below[0] ? 1 : 0 );
+		for( int x = 1; x < p_cols - 1; x++ ) {
+			int l = below[x - 1] + COST_TURN;
+			int c = below[x];
+			int r = below[x + 1] + COST_TURN;
+			int best = min( c, min( l, r ) );
+			acc[x] = cost[x] + best;
+			from[x] = (signed char)( ( l == best && l < c ) ? -1 : ( ( r == best && r < c ) ? 1 : 0 ) );
+		}
+		int last = p_cols - 1;
+		acc[last] = cost[last] + min( below[last], below[last - 1] + COST_TURN );
+		from[last] = (signed char)( below[last - 1] + COST_TURN < below[last] ? -1 : 0 );
+	}
+
+	//cheapest pixel in the top row, then follow it back down
+	acc = &p_acc[0];
+	int x = (int)( std::min_element( acc, acc + p_cols ) - acc );
+	std::vector<int> path( p_rows );
+	for( int y = 0; y < p_rows; y++ ) {
+		path[y] = x;
+		x += p_from[y * p_cols + x];
+	}
+
+	//route from the bottom up until the path hits something
+	for( int y = p_rows - 1; y >= 0; y-- ) {
+		int px = path[y];
+		int index = y * p_cols + px;
+		if( p_class[index] != CLASS_FREE ) {
+			blockedRow = y;
+			blockedByObstacle = ( p_class[index] == CLASS_OBSTACLE );
+			obstacleOnRight = ( px >= mid );
+			break;
+		}
+		route->push_back( px );
+		objInRow->push_back( p_nearObstacle[index] != 0 );
+	}
+}
@@ -0,0 +1,42 @@
+/******************************************************************************
+ * CostMap Class - Route engine that gives every pixel a cost from the edge
+ *                 and obstacle masks (blocked pixels, and pixels too close
+ *                 to something for the truck to fit) and finds the cheapest
+ *                 connected path from the bottom of the frame to the top
+ *                 with dynamic programming, seam carving style.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+class CostMap {
+	//variables
+public:
+	int blockedRow;          //first row from the bottom the path is blocked (-1 none)
+	bool blockedByObstacle;  //the blocked pixel is an obstacle (not an edge)
+	bool obstacleOnRight;    //the blocked pixel is right of center
+
+	//methods
+public:
+	CostMap();
+	void build(cv::Mat frameEdges, cv::Mat frameObstacles, const std::vector<int> &minGap);
+	void solve(std::vector<int> *route, std::vector<bool> *objInRow);
+
+	//private variables
+private:
+	int p_cols;
+	int p_rows;
+	std::vector<int> p_cost;            //cost of each pixel
+	std::vector<int> p_acc;             //cheapest path cost from the bottom
+	std::vector<signed char> p_from;    //column step (-1, 0, 1) the path came from
+	std::vector<unsigned char> p_class; //0 free, 1 edge, 2 obstacle
+	std::vector<unsigned char> p_nearObstacle; //1 left, 2 right, 0 not near
+	std::vector<int> p_left;            //row scratch: distance to blocked on left
+	std::vector<int> p_leftObs;         //row scratch: distance to obstacle on left
+};
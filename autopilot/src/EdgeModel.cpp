@@ -0,0 +1,181 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "EdgeModel.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+
+/****************************** Definitions **********************************/
+
+//rows between samples
+#define EDGE_FIT_ROW_STEP 4
+//pixels either side of last frame's curve searched for the edge
+#define EDGE_FIT_SEARCH 8
+//points needed for a fit
+#define EDGE_FIT_MIN_POINTS 4
+//points further than this (pixels) from the first fit are dropped
+#define EDGE_FIT_OUTLIER 4.0
+//frames an old fit is kept when the mask doesn't give enough points
+#define EDGE_FIT_MAX_AGE 5
+//pixels inside a fitted edge a point has to be to count as between them
+#define EDGE_FIT_MARGIN 2
+
+/****************************** Implementation *******************************/
+
+EdgeModel::EdgeModel( void )
+{
+	p_cols = 0;
+	p_rows = 0;
+	reset();
+}
+
+void EdgeModel::reset( void )
+{
+	left.a = left.b = left.c = 0;
+	left.valid = false;
+	left.age = 0;
+	left.points = 0;
+	right = left;
+}
+
+void EdgeModel::update( cv::Mat frameEdges )
+{
+	//a new frame size makes the old curves meaningless
+	if( frameEdges.cols != p_cols || frameEdges.rows != p_rows ) {
+		p_cols = frameEdges.cols;
+		p_rows = frameEdges.rows;
+		reset();
+	}
+
+	update_side( frameEdges, -1, &left );
+	update_side( frameEdges, 1, &right );
+}
+
+//x is between the two fitted edges with room for something width pixels wide
+bool EdgeModel::covers( int x, int y, int width )
+{
+	if( !left.valid || !right.valid )
+		return false;
+	int l = left_at( y );
+	int r = right_at( y );
+	return ( x > l + EDGE_FIT_MARGIN && x < r - EDGE_FIT_MARGIN && r - l >= width );
+}
+
+int EdgeModel::at( const EDGE_CURVE_T &curve, int y )
+{
+	double t = (double)y / p_rows;
+	return (int)( curve.a + t * ( curve.b + t * curve.c ) );
+}
+
+//Collect one edge point per sampled row on one side (dir -1 left, 1 right)
+//and fit them. Near the old curve when we have one, otherwise the first
+//edge pixel out from the center.
+void EdgeModel::update_side( cv::Mat frameEdges, int dir, EDGE_CURVE_T *curve )
+{
+	p_points.clear();
+	int center = p_cols / 2;
+
+	for( int y = p_rows - 1; y >= 0; y -= EDGE_FIT_ROW_STEP ) {
+		const uchar *row = frameEdges.ptr<uchar>( y );
+		int found = -1;
+
+		if( curve->valid ) {
+			//closest edge pixel to where the curve says it should be
+			int predicted = at( *curve, y );
+			for( int d = 0; d <= EDGE_FIT_SEARCH && found < 0; d++ ) {
+				int x0 = predicted - d;
+				int x1 = predicted + d;
+				if( x0 >= 0 && x0 < p_cols && row[x0] != 0 )
+					found = x0;
+				else if( x1 >= 0 && x1 < p_cols && row[x1] != 0 )
+					found = x1;
+			}
+		}
+		else {
+			for( int x = center; x >= 0 && x < p_cols; x += dir ) {
+				if( row[x] != 0 ) {
+					found = x;
+					break;
+				}
+			}
+		}
+
+		if( found >= 0 )
+			p_points.push_back( cv::Point( found, y ) );
+	}
+
+	if( fit( p_points, curve ) ) {
+		curve->valid = true;
+		curve->age = 0;
+	}
+	else if( curve->valid && ++curve->age > EDGE_FIT_MAX_AGE ) {
+		//lost it, start over from the center next frame
+		curve->valid = false;
+	}
+}
+
+//Least squares fit, then again without the points far from the first fit
+bool EdgeModel::fit( const std::vector<cv::Point> &points, EDGE_CURVE_T *curve )
+{
+	std::vector<char> use( points.size(), 1 );
+	EDGE_CURVE_T result = *curve;
+
+	for( int pass = 0; pass < 2; pass++ ) {
+		//sums for the normal equations
+		double s[5] = { 0, 0, 0, 0, 0 };
+		double sx[3] = { 0, 0, 0 };
+		int n = 0;
+		for( int i = 0; i < (int)points.size(); i++ ) {
+			if( !use[i] )
+				continue;
+			double t = (double)points[i].y / p_rows;
+			double tk = 1;
+			for( int k = 0; k < 5; k++ ) {
+				s[k] += tk;
+				if( k < 3 )
+					sx[k] += tk * points[i].x;
+				tk *= t;
+			}
+			n++;
+		}
+		if( n < EDGE_FIT_MIN_POINTS )
+			return ( pass > 0 );
+
+		//solve the 3x3 system with Cramer's rule
+		double det = s[0] * ( s[2] * s[4] - s[3] * s[3] )
+				- s[1] * ( s[1] * s[4] - s[3] * s[2] )
+				+ s[2] * ( s[1] * s[3] - s[2] * s[2] );
+		if( fabs( det ) < 1e-12 )
+			return ( pass > 0 );
+		result.a = ( sx[0] * ( s[2] * s[4] - s[3] * s[3] )
+				- s[1] * ( sx[1] * s[4] - s[3] * sx[2] )
+				+ s[2] * ( sx[1] * s[3] - s[2] * sx[2] ) ) / det;
+		result.b = ( s[0] * ( sx[1] * s[4] - s[3] * sx[2] )
+				- sx[0] * ( s[1] * s[4] - s[3] * s[2] )
+				+ s[2] * ( s[1] * sx[2] - sx[1] * s[2] ) ) / det;
+		result.c = ( s[0] * ( s[2] * sx[2] - sx[1] * s[3] )
+				- s[1] * ( s[1] * sx[2] - sx[1] * s[2] )
+				+ sx[0] * ( s[1] * s[3] - s[2] * s[2] ) ) / det;
+		result.points = n;
+		curve->a = result.a;
+		curve->b = result.b;
+		curve->c = result.c;
+		curve->points = n;
+
+		//drop the outliers for the second pass
+		for( int i = 0; i < (int)points.size(); i++ ) {
+			double t = (double)points[i].y / p_rows;
+			double x = result.a + t * ( result.b + t * result.c );
+			if( fabs( x - points[i].x ) > EDGE_FIT_OUTLIER )
+				use[i] = 0;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * EdgeModel Class - Fits the left and right course edges (blue tape) as
+ *                   curves x = a + b*t + c*t^2 down the image (t = y / rows)
+ *                   from the edge mask. Each frame searches near last
+ *                   frame's curves, so only a few pixels per sampled row are
+ *                   read, and outliers are dropped before the final fit.
+ *                   Where an edge is at any row is then one evaluation.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+/****************************** Definitions **********************************/
+
+/** One fitted course edge */
+typedef struct EDGE_CURVE_S {
+	double a;
+	double b;
+	double c;
+	bool valid;   //there is a fit to use
+	int age;      //frames since the fit last had enough points
+	int points;   //points used for the last fit
+} EDGE_CURVE_T;
+
+class EdgeModel {
+	//variables
+public:
+	EDGE_CURVE_T left;
+	EDGE_CURVE_T right;
+
+	//methods
+public:
+	EdgeModel();
+	void reset(void);
+	void update(cv::Mat frameEdges);
+	int left_at(int y) { return at(left, y); }
+	int right_at(int y) { return at(right, y); }
+	int center_at(int y) { return (at(left, y) + at(right, y)) / 2; }
+	bool covers(int x, int y, int width);
+
+	//private variables
+private:
+	int p_cols;
+	int p_rows;
+	std::vector<cv::Point> p_points;
+
+	//private methods
+private:
+	int at(const EDGE_CURVE_T &curve, int y);
+	void update_side(cv::Mat frameEdges, int dir, EDGE_CURVE_T *curve);
+	bool fit(const std::vector<cv::Point> &points, EDGE_CURVE_T *curve);
+};
@@ -0,0 +1,325 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "FrameBus.hpp"
+
+#include <iostream>
+#include <new>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/****************************** Definitions **********************************/
+
+#define FRAME_BUS_MAGIC 0x4f544246
+//time between looks for a new frame
+#define FRAME_BUS_POLL_US 500
+
+#define LATEST_SEQ(l) ((l) >> 8)
+#define LATEST_SLOT(l) ((int)((l) & 0xff))
+
+using std::cout;
+using std::endl;
+
+/****************************** Implementation *******************************/
+
+FrameBus::FrameBus( void )
+{
+	p_fd = -1;
+	p_size = 0;
+	p_name[0] = 0;
+	p_writer = false;
+	p_header = NULL;
+	p_reader = -1;
+	p_seq = 0;
+	p_leased = false;
+}
+
+FrameBus::~FrameBus( void )
+{
+	close();
+}
+
+//Make the shared memory for frames of this size and format (replaces one a
+//dead writer left behind)
+bool FrameBus::create( const char *name, int width, int height, CAMERA_FORMAT_T format )
+{
+	close();
+	int channels = ( format == CAMERA_FORMAT_YUYV ) ? 2 : 3;
+	int frameBytes = width * height * channels;
+	p_size = sizeof(FRAME_BUS_HEADER_T) + (size_t)frameBytes * FRAME_BUS_SLOTS;
+
+	shm_unlink( name );
+	p_fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0666 );
+	if( p_fd < 0 || ftruncate( p_fd, p_size ) < 0 ) {
+		cout << "Error: Unable to create frame bus " << name << ": " << strerror( errno ) << endl;
+		close();
+		return false;
+	}
+	void *mem = mmap( NULL, p_size, PROT_READ | PROT_WRITE, MAP_SHARED, p_fd, 0 );
+	if( mem == MAP_FAILED ) {
+		close();
+		return false;
+	}
+
+	p_header = new( mem ) FRAME_BUS_HEADER_T;
+	p_header->width = width;
+	p_header->height = height;
+	p_header->format = format;
+	p_header->frameBytes = frameBytes;
+	p_header->latest = 0;
+	for( int r = 0; r < FRAME_BUS_READERS; r++ ) {
+		p_header->readers[r].pid = 0;
+		p_header->readers[r].pinned = 0;
+		p_header->readers[r].lastSeq = 0;
+		p_header->readers[r].frames = 0;
+	}
+	for( int s = 0; s < FRAME_BUS_SLOTS; s++ ) {
+		p_header->slots[s].seq = 0;
+		p_header->slots[s].time = 0;
+	}
+	p_header->writerPid = getpid();
+	//readers check the magic last
+	std::atomic_thread_fence( std::memory_order_release );
+	p_header->magic = FRAME_BUS_MAGIC;
+
+	strncpy( p_name, name, sizeof(p_name) - 1 );
+	p_name[sizeof(p_name) - 1] = 0;
+	p_writer = true;
+	p_seq = 0;
+	return true;
+}
+
+//Map a bus a live writer has made. Returns false if there isn't one.
+bool FrameBus::attach( const char *name )
+{
+	close();
+	p_fd = shm_open( name, O_RDWR, 0 );
+	if( p_fd < 0 )
+		return false;
+
+	struct stat st;
+	if( fstat( p_fd, &st ) < 0 || (size_t)st.st_size < sizeof(FRAME_BUS_HEADER_T) ) {
+		close();
+		return false;
+	}
+	p_size = st.st_size;
+	void *mem = mmap( NULL, p_size, PROT_READ | PROT_WRITE, MAP_SHARED, p_fd, 0 );
+	if( mem == MAP_FAILED ) {
+		close();
+		return false;
+	}
+	p_header = (FRAME_BUS_HEADER_T *)mem;
+
+	if( p_header->magic != FRAME_BUS_MAGIC || !writer_alive() ||
+			p_size < sizeof(FRAME_BUS_HEADER_T) + (size_t)p_header->frameBytes * FRAME_BUS_SLOTS ||
+			!claim_reader() ) {
+		close();
+		return false;
+	}
+
+	p_writer = false;
+	p_seq = 0;
+	return true;
+}
+
+void FrameBus::close( void )
+{
+	if( p_header != NULL ) {
+		if( p_writer ) {
+			p_header->writerPid = 0;
+			shm_unlink( p_name );
+		}
+		else if( p_reader >= 0 ) {
+			p_header->readers[p_reader].pinned = 0;
+			p_header->readers[p_reader].pid = 0;
+		}
+		munmap( p_header, p_size );
+	}
+	if( p_fd >= 0 )
+		::close( p_fd );
+
+	p_fd = -1;
+	p_header = NULL;
+	p_reader = -1;
+	p_writer = false;
+}
+
+//Copy a frame into a slot no reader is using and make it the newest. Never
+//waits, there is always a free slot.
+bool FrameBus::publish( cv::Mat image, double time )
+{
+	if( !p_writer || image.rows != p_header->height || image.cols != p_header->width ||
+			(int)( image.total() * image.elemSize() ) != p_header->frameBytes )
+		return false;
+
+	int newest = LATEST_SLOT( p_header->latest.load() );
+	uint64_t seq = p_seq + 1;
+	for( int s = 0; s < FRAME_BUS_SLOTS; s++ ) {
+		if( s == newest && p_seq != 0 )
+			continue;
+
+		//take the slot away from new readers first, then check no reader
+		//got in before us (a reader pins first and then checks the slot)
+		FRAME_BUS_SLOT_T &slot = p_header->slots[s];
+		uint64_t old = slot.seq.exchange( 0 );
+		if( old != 0 && slot_pinned( old ) ) {
+			slot.seq = old;
+			continue;
+		}
+
+		//rows may be padded (a driver buffer), the slot's aren't
+		unsigned char *dst = slot_data( s );
+		size_t rowBytes = image.cols * image.elemSize();
+		for( int y = 0; y < image.rows; y++ )
+			memcpy( dst + y * rowBytes, image.ptr( y ), rowBytes );
+		slot.time = time;
+
+		slot.seq = seq;
+		p_header->latest = ( seq << 8 ) | (uint64_t)s;
+		p_seq = seq;
+		return true;
+	}
+	return false;
+}
+
+//Newest frame we haven't seen yet, in place. It stays pinned (the writer
+//won't touch it) until the last copy of frame->lease is gone. We only have
+//one pin, so this fails while the last frame is still leased out.
+bool FrameBus::acquire( CAMERA_FRAME_T *frame, int timeoutMs )
+{
+	frame->lease.reset();
+	frame->image.release();
+	if( p_header == NULL || p_writer || p_leased )
+		return false;
+
+	FRAME_BUS_READER_T &reader = p_header->readers[p_reader];
+	int waited = 0;
+	while( true ) {
+		uint64_t latest = p_header->latest.load();
+		uint64_t seq = LATEST_SEQ( latest );
+		int s = LATEST_SLOT( latest );
+
+		if( seq == 0 || seq == p_seq ) {
+			//nothing new yet
+			if( waited >= timeoutMs * 1000 || !writer_alive() )
+				return false;
+			usleep( FRAME_BUS_POLL_US );
+			waited += FRAME_BUS_POLL_US;
+			continue;
+		}
+
+		//pin, then make sure the writer hasn't started on the slot
+		reader.pinned = seq;
+		if( p_header->slots[s].seq.load() != seq ) {
+			reader.pinned = 0;
+			continue;
+		}
+
+		//skipped frames show up as gaps in lastSeq
+		reader.lastSeq = seq;
+		reader.frames++;
+		p_seq = seq;
+
+		int type = ( p_header->format == CAMERA_FORMAT_YUYV ) ? CV_8UC2 : CV_8UC3;
+		frame->image = cv::Mat( p_header->height, p_header->width, type, slot_data( s ) );
+		frame->format = (CAMERA_FORMAT_T)p_header->format;
+		frame->time = p_header->slots[s].time;
+		frame->sequence = (long)seq;
+		p_leased = true;
+		frame->lease = std::shared_ptr<void>( slot_data( s ),
+				[this, seq]( void * ) { release( seq ); },
+				LeaseAllocator<char>( &p_leases ) );
+		return true;
+	}
+}
+
+//A frame's lease is gone, unpin it (only if it's still the one pinned)
+void FrameBus::release( uint64_t seq )
+{
+	if( p_header != NULL && p_reader >= 0 ) {
+		uint64_t expected = seq;
+		p_header->readers[p_reader].pinned.compare_exchange_strong( expected, 0 );
+	}
+	p_leased = false;
+}
+
+bool FrameBus::writer_alive( void )
+{
+	if( p_header == NULL )
+		return false;
+	int32_t pid = p_header->writerPid;
+	return pid != 0 && ( kill( pid, 0 ) == 0 || errno == EPERM );
+}
+
+int FrameBus::width( void )
+{
+	return p_header ? p_header->width : 0;
+}
+
+int FrameBus::height( void )
+{
+	return p_header ? p_header->height : 0;
+}
+
+CAMERA_FORMAT_T FrameBus::format( void )
+{
+	return p_header ? (CAMERA_FORMAT_T)p_header->format : CAMERA_FORMAT_BGR;
+}
+
+//How far behind the newest frame each reader is
+void FrameBus::print_readers( void )
+{
+	if( p_header == NULL )
+		return;
+	uint64_t newest = LATEST_SEQ( p_header->latest.load() );
+	for( int r = 0; r < FRAME_BUS_READERS; r++ ) {
+		FRAME_BUS_READER_T &reader = p_header->readers[r];
+		if( reader.pid == 0 )
+			continue;
+		cout << "Reader " << reader.pid << ": read " << reader.frames
+			<< ", behind " << newest - reader.lastSeq << endl;
+	}
+}
+
+unsigned char *FrameBus::slot_data( int slot )
+{
+	return (unsigned char *)( p_header + 1 ) + (size_t)slot * p_header->frameBytes;
+}
+
+bool FrameBus::slot_pinned( uint64_t seq )
+{
+	for( int r = 0; r < FRAME_BUS_READERS; r++ )
+		if( p_header->readers[r].pinned.load() == seq )
+			return true;
+	return false;
+}
+
+//Take a free reader entry, or one whose process has died
+bool FrameBus::claim_reader( void )
+{
+	int32_t me = getpid();
+	for( int r = 0; r < FRAME_BUS_READERS; r++ ) {
+		FRAME_BUS_READER_T &reader = p_header->readers[r];
+		int32_t pid = reader.pid;
+		bool dead = ( pid != 0 && kill( pid, 0 ) < 0 && errno == ESRCH );
+		if( ( pid == 0 || dead ) && reader.pid.compare_exchange_strong( pid, me ) ) {
+			reader.pinned = 0;
+			reader.lastSeq = 0;
+			reader.frames = 0;
+			p_reader = r;
+			return true;
+		}
+	}
+	cout << "Error: No free frame bus reader entries." << endl;
+	return false;
+}
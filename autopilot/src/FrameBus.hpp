@@ -0,0 +1,97 @@
+/******************************************************************************
+ * FrameBus Class - Frames from one capture process shared with any number
+ *                  of local readers through a POSIX shared memory ring.
+ *
+ *                  The writer never waits on a reader. Each reader pins the
+ *                  one frame it is using (and records how far it has got),
+ *                  the writer fills any slot that isn't pinned, so a slow
+ *                  or dead reader only ever holds on to one slot. Readers
+ *                  see frames in place, nothing is copied, and hold one
+ *                  frame at a time (drop its lease before the next).
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <stdint.h>
+
+#include "Camera.hpp"
+
+/****************************** Definitions **********************************/
+
+/** Shared memory name the capture process publishes on */
+#define FRAME_BUS_NAME "/odroid_truck_frames"
+/** Readers that can be attached at once */
+#define FRAME_BUS_READERS 6
+/** Frame slots (one per reader plus the newest frame plus one being written) */
+#define FRAME_BUS_SLOTS (FRAME_BUS_READERS + 2)
+
+/** A reader's entry, claimed by pid */
+typedef struct FRAME_BUS_READER_S {
+	std::atomic<int32_t> pid;       //0 free
+	std::atomic<uint64_t> pinned;   //sequence being read (0 none)
+	std::atomic<uint64_t> lastSeq;  //last sequence read
+	std::atomic<uint64_t> frames;   //frames read
+} FRAME_BUS_READER_T;
+
+/** A frame slot, the pixels follow the slot table */
+typedef struct FRAME_BUS_SLOT_S {
+	std::atomic<uint64_t> seq;      //sequence in the slot (0 empty or being written)
+	double time;
+} FRAME_BUS_SLOT_T;
+
+/** Start of the shared memory */
+typedef struct FRAME_BUS_HEADER_S {
+	uint32_t magic;
+	int32_t width;
+	int32_t height;
+	int32_t format;                 //CAMERA_FORMAT_T
+	int32_t frameBytes;
+	std::atomic<int32_t> writerPid; //0 once the writer has closed
+	std::atomic<uint64_t> latest;   //sequence << 8 | slot of the newest frame
+	FRAME_BUS_READER_T readers[FRAME_BUS_READERS];
+	FRAME_BUS_SLOT_T slots[FRAME_BUS_SLOTS];
+} FRAME_BUS_HEADER_T;
+
+class FrameBus {
+	//methods
+public:
+	FrameBus();
+	~FrameBus();
+	bool create(const char *name, int width, int height, CAMERA_FORMAT_T format);
+	bool attach(const char *name);
+	void close(void);
+	bool publish(cv::Mat image, double time);
+	bool acquire(CAMERA_FRAME_T *frame, int timeoutMs);
+	bool writer_alive(void);
+	int width(void);
+	int height(void);
+	CAMERA_FORMAT_T format(void);
+	void print_readers(void);
+
+	//private variables
+private:
+	int p_fd;
+	size_t p_size;
+	char p_name[64];
+	bool p_writer;
+	FRAME_BUS_HEADER_T *p_header;
+	int p_reader;        //our reader entry (-1 writer)
+	uint64_t p_seq;      //last sequence written or read
+	LeasePool p_leases;  //control blocks for frame leases
+	std::atomic<bool> p_leased;  //a frame we acquired is still leased out
+
+	//private methods
+private:
+	FrameBus(const FrameBus &);
+	FrameBus &operator=(const FrameBus &);
+	unsigned char *slot_data(int slot);
+	bool slot_pinned(uint64_t seq);
+	void release(uint64_t seq);
+	bool claim_reader(void);
+};
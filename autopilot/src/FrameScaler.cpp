@@ -0,0 +1,109 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "FrameScaler.hpp"
+
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+
+/****************************** Definitions **********************************/
+
+/****************************** Implementation *******************************/
+
+FrameScaler::FrameScaler( void )
+{
+	p_width = CAMERA_WIDTH;
+	p_height = CAMERA_HEIGHT;
+}
+
+//Shrunk copy of src in dst. dst is our buffer (reused every frame), a frame
+//that is already small enough is passed through as is.
+void FrameScaler::scale( const CAMERA_FRAME_T &src, CAMERA_FRAME_T *dst )
+{
+	dst->format = src.format;
+	dst->time = src.time;
+	dst->sequence = src.sequence;
+	//(only ever shrinks, a smaller frame is the planner's problem)
+	if( src.image.cols <= p_width || src.image.rows <= p_height ) {
+		dst->image = src.image;
+		dst->lease = src.lease;
+		return;
+	}
+
+	dst->lease.reset();
+	if( src.format == CAMERA_FORMAT_YUYV ) {
+		p_out.create( p_height, p_width, CV_8UC2 );
+		scale_yuyv( src.image, p_out );
+	}
+	else {
+		resize( src.image, p_out, cv::Size( p_width, p_height ), 0, 0, cv::INTER_AREA );
+	}
+	dst->image = p_out;
+}
+
+//Average each output pixel's block of source rows and columns. A block's
+//source rows are first added into one row of byte sums, a plain add over
+//contiguous bytes that gets vectorized when built with -ftree-vectorize (or
+//-O3, and on the XU4 only with -mfpu=neon), then each output pixel pair
+//adds up its columns from that once. Every output pair gets its own U and V
+//from its source pairs, and its source pixels are split evenly between Y0
+//and Y1 (with an odd number of pairs the middle one gives a pixel to each).
+void FrameScaler::scale_yuyv( cv::Mat src, cv::Mat dst )
+{
+	int srcPairs = src.cols / 2;
+	int dstPairs = dst.cols / 2;
+	int rowBytes = srcPairs * 4;
+	p_sums.resize( rowBytes );
+	uint32_t *sums = &p_sums[0];
+
+	for( int y = 0; y < dst.rows; y++ ) {
+		int top = ( y * src.rows ) / dst.rows;
+		int bottom = ( ( y + 1 ) * src.rows ) / dst.rows;
+		std::fill( p_sums.begin(), p_sums.end(), 0 );
+
+		//add up the source rows
+		for( int sy = top; sy < bottom; sy++ ) {
+			const uchar *px = src.ptr<uchar>( sy );
+			for( int x = 0; x < rowBytes; x++ )
+				sums[x] += px[x];
+		}
+
+		//add up each output pair's columns and divide by the block size
+		uchar *out = dst.ptr<uchar>( y );
+		int rows = bottom - top;
+		for( int i = 0; i < dstPairs; i++ ) {
+			int first = ( i * srcPairs ) / dstPairs;
+			int pairs = ( ( i + 1 ) * srcPairs ) / dstPairs - first;
+			uint32_t y0 = 0;
+			uint32_t y1 = 0;
+			uint32_t u = 0;
+			uint32_t v = 0;
+			for( int j = 0; j < pairs; j++ ) {
+				//pixels 2j and 2j+1 of the block, the first half make Y0
+				const uint32_t *pair = sums + ( first + j ) * 4;
+				if( 2 * j < pairs )
+					y0 += pair[0];
+				else
+					y1 += pair[0];
+				if( 2 * j + 1 < pairs )
+					y0 += pair[2];
+				else
+					y1 += pair[2];
+				u += pair[1];
+				v += pair[3];
+			}
+
+			//each of Y0, Y1, U and V averages pairs pixels per row
+			uint32_t count = pairs * rows;
+			out[i * 4 + 0] = (uchar)( y0 / count );
+			out[i * 4 + 1] = (uchar)( u / count );
+			out[i * 4 + 2] = (uchar)( y1 / count );
+			out[i * 4 + 3] = (uchar)( v / count );
+		}
+	}
+}
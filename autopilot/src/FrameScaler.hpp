@@ -0,0 +1,37 @@
+/******************************************************************************
+ * FrameScaler Class - Shrinks camera frames to the planner's resolution.
+ *                     YUYV frames are box filtered in YUYV (Y, U and V
+ *                     averaged separately, so they aren't mixed like a
+ *                     plain resize would), BGR frames go through resize.
+ *                     Buffers are made on the first frame and reused.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+#include <stdint.h>
+
+#include "Camera.hpp"
+
+class FrameScaler {
+	//methods
+public:
+	FrameScaler();
+	void scale(const CAMERA_FRAME_T &src, CAMERA_FRAME_T *dst);
+
+	//private variables
+private:
+	int p_width;
+	int p_height;
+	cv::Mat p_out;
+	std::vector<uint32_t> p_sums;   //source row byte sums over one output row's block
+
+	//private methods
+private:
+	void scale_yuyv(cv::Mat src, cv::Mat dst);
+};
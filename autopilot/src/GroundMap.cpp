@@ -0,0 +1,152 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "GroundMap.hpp"
+
+#include <math.h>
+#include <string.h>
+
+/****************************** Definitions **********************************/
+
+//Default calibration for the truck's camera (measure again if it moves)
+#define GROUND_CAMERA_HEIGHT 0.20
+#define GROUND_CAMERA_TILT (20.0 * M_PI / 180.0)
+#define GROUND_CAMERA_HFOV (60.0 * M_PI / 180.0)
+#define GROUND_CELL_SIZE 0.02
+#define GROUND_HALF_WIDTH 0.60
+#define GROUND_NEAR_DIST 0.10
+#define GROUND_FAR_DIST 2.00
+
+/****************************** Implementation *******************************/
+
+GroundMap::GroundMap( void )
+{
+	gridCols = 0;
+	gridRows = 0;
+	p_cols = 0;
+	p_rows = 0;
+	p_focal = 0;
+	memset( &p_camera, 0, sizeof p_camera );
+}
+
+GROUND_CAMERA_T GroundMap::default_camera( void )
+{
+	GROUND_CAMERA_T c;
+
+	c.height = GROUND_CAMERA_HEIGHT;
+	c.tilt = GROUND_CAMERA_TILT;
+	c.hfov = GROUND_CAMERA_HFOV;
+	c.cellSize = GROUND_CELL_SIZE;
+	c.halfWidth = GROUND_HALF_WIDTH;
+	c.nearDist = GROUND_NEAR_DIST;
+	c.farDist = GROUND_FAR_DIST;
+
+	return c;
+}
+
+bool GroundMap::built_for( int cols, int rows, const GROUND_CAMERA_T &camera )
+{
+	return ( p_cols == cols && p_rows == rows &&
+			memcmp( &p_camera, &camera, sizeof camera ) == 0 );
+}
+
+//Project the center of every ground cell into the image and remember which
+//pixel it lands on
+void GroundMap::build( int cols, int rows, const GROUND_CAMERA_T &camera )
+{
+	p_cols = cols;
+	p_rows = rows;
+	p_camera = camera;
+	p_focal = ( cols / 2.0f ) / tanf( camera.hfov / 2.0f );
+
+	gridCols = (int)( 2.0f * camera.halfWidth / camera.cellSize );
+	gridRows = (int)( ( camera.farDist - camera.nearDist ) / camera.cellSize );
+	if( gridCols < 1 )
+		gridCols = 1;
+	if( gridRows < 1 )
+		gridRows = 1;
+	p_table.resize( gridCols * gridRows );
+
+	float sinT = sinf( camera.tilt );
+	float cosT = cosf( camera.tilt );
+	float cx = cols / 2.0f;
+	float cy = rows / 2.0f;
+	for( int gy = 0; gy < gridRows; gy++ ) {
+		//far row first
+		float ahead = camera.farDist - ( gy + 0.5f ) * camera.cellSize;
+		for( int gx = 0; gx < gridCols; gx++ ) {
+			float side = ( gx + 0.5f ) * camera.cellSize - camera.halfWidth;
+
+			//into camera coordinates (z along the lens, y down the image)
+			float z = ahead * cosT + camera.height * sinT;
+			float y = camera.height * cosT - ahead * sinT;
+			int idx = -1;
+			if( z > 0 ) {
+				int u = (int)( cx + p_focal * side / z );
+				int v = (int)( cy + p_focal * y / z );
+				if( u >= 0 && u < cols && v >= 0 && v < rows )
+					idx = v * cols + u;
+			}
+			p_table[gy * gridCols + gx] = idx;
+		}
+	}
+}
+
+//Label every ground cell from the pixel it sees
+void GroundMap::warp( cv::Mat frameEdges, cv::Mat frameObstacles, cv::Mat *ground )
+{
+	ground->create( gridRows, gridCols, CV_8UC1 );
+	if( !frameEdges.isContinuous() )
+		frameEdges = frameEdges.clone();
+	if( !frameObstacles.isContinuous() )
+		frameObstacles = frameObstacles.clone();
+	const uchar *edges = frameEdges.ptr<uchar>( 0 );
+	const uchar *obstacles = frameObstacles.ptr<uchar>( 0 );
+	const int *table = &p_table[0];
+	uchar *cell = ground->ptr<uchar>( 0 );
+
+	//masks are continuous, so the table indexes them directly
+	int num = gridCols * gridRows;
+	for( int i = 0; i < num; i++ ) {
+		int idx = table[i];
+		if( idx < 0 )
+			cell[i] = GROUND_UNSEEN;
+		else if( obstacles[idx] != 0 )
+			cell[i] = GROUND_OBSTACLE;
+		else if( edges[idx] != 0 )
+			cell[i] = GROUND_EDGE;
+		else
+			cell[i] = GROUND_FREE;
+	}
+}
+
+//Pixels wide something meters across is at image row y, straight ahead.
+//Returns 0 for rows at or above the horizon.
+float GroundMap::width_px( int y, float meters )
+{
+	float dy = ( y - p_rows / 2.0f ) / p_focal;
+	float down = sinf( p_camera.tilt ) + dy * cosf( p_camera.tilt );
+	if( down <= 0 )
+		return 0;
+	return meters * p_focal * down / p_camera.height;
+}
+
+//Where image pixel (x, y) is on the ground, x to the right and y ahead of
+//the lens in meters. Returns (0, -1) for pixels at or above the horizon.
+cv::Point2f GroundMap::to_ground( int x, int y )
+{
+	float dx = ( x - p_cols / 2.0f ) / p_focal;
+	float dy = ( y - p_rows / 2.0f ) / p_focal;
+	float sinT = sinf( p_camera.tilt );
+	float cosT = cosf( p_camera.tilt );
+	float down = sinT + dy * cosT;
+	if( down <= 0 )
+		return cv::Point2f( 0, -1 );
+	float t = p_camera.height / down;
+	return cv::Point2f( t * dx, t * ( cosT - dy * sinT ) );
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+ * GroundMap Class - Bird's eye (inverse perspective) view of the ground in
+ *                   front of the truck. A table built once per camera
+ *                   calibration and frame size gives the image pixel each
+ *                   ground cell sees, so warping the obstacle and edge masks
+ *                   is one lookup per cell. Also gives how many pixels wide
+ *                   something is on the ground at any image row.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+/****************************** Definitions **********************************/
+
+/** Ground cell labels */
+#define GROUND_FREE 0
+#define GROUND_EDGE 1
+#define GROUND_OBSTACLE 2
+#define GROUND_UNSEEN 255
+
+/** Camera mounting and ground grid (meters and radians) */
+typedef struct GROUND_CAMERA_S {
+	float height;     //lens above the ground
+	float tilt;       //down from level
+	float hfov;       //horizontal field of view
+	float cellSize;   //ground cell edge length
+	float halfWidth;  //grid covers this far to each side of the truck
+	float nearDist;   //grid starts this far ahead of the lens
+	float farDist;    //and ends here
+} GROUND_CAMERA_T;
+
+class GroundMap {
+	//variables
+public:
+	int gridCols;  //cells across, left to right
+	int gridRows;  //cells ahead, far row first (like the image)
+
+	//methods
+public:
+	GroundMap();
+	static GROUND_CAMERA_T default_camera(void);
+	bool built_for(int cols, int rows, const GROUND_CAMERA_T &camera);
+	void build(int cols, int rows, const GROUND_CAMERA_T &camera);
+	void warp(cv::Mat frameEdges, cv::Mat frameObstacles, cv::Mat *ground);
+	float width_px(int y, float meters);
+	cv::Point2f to_ground(int x, int y);
+
+	//private variables
+private:
+	int p_cols;
+	int p_rows;
+	GROUND_CAMERA_T p_camera;
+	float p_focal;            //focal length in pixels
+	std::vector<int> p_table; //image pixel index for each cell (-1 unseen)
+};
@@ -0,0 +1,36 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "LeasePool.hpp"
+
+/****************************** Implementation *******************************/
+
+LeasePool::LeasePool( void )
+{
+	for( int i = 0; i < LEASE_POOL_BLOCKS; i++ )
+		p_free[i] = LEASE_POOL_BLOCKS - 1 - i;
+	p_freeCount = LEASE_POOL_BLOCKS;
+}
+
+//A free block, NULL if every one is in use
+void *LeasePool::take( void )
+{
+	std::lock_guard<std::mutex> guard( p_lock );
+	if( p_freeCount == 0 )
+		return NULL;
+	p_freeCount--;
+	return p_blocks[p_free[p_freeCount]].bytes;
+}
+
+void LeasePool::give( void *block )
+{
+	std::lock_guard<std::mutex> guard( p_lock );
+	int index = (int)( static_cast<LEASE_BLOCK_T *>( block ) - p_blocks );
+	p_free[p_freeCount] = index;
+	p_freeCount++;
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+ * LeasePool Class - Fixed blocks for the shared_ptr control blocks of frame
+ *                   leases, so leasing a frame out never touches the heap.
+ *                   LeaseAllocator hands the blocks to std::shared_ptr.
+ *
+ *                   Blocks are taken when a lease is made and given back
+ *                   from whichever thread drops its last copy.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stddef.h>
+
+/****************************** Definitions **********************************/
+
+/** Leases that can be out at once (every V4L2 buffer the driver can give us,
+ *  the BGR pool and a frame bus frame) */
+#define LEASE_POOL_BLOCKS 48
+/** Bytes per block, enough for a control block with a small deleter */
+#define LEASE_BLOCK_BYTES 128
+
+/** One block, aligned for anything a control block holds */
+typedef struct LEASE_BLOCK_S {
+	alignas(16) unsigned char bytes[LEASE_BLOCK_BYTES];
+} LEASE_BLOCK_T;
+
+class LeasePool {
+	//methods
+public:
+	LeasePool();
+	void *take(void);
+	void give(void *block);
+
+	//private variables
+private:
+	LEASE_BLOCK_T p_blocks[LEASE_POOL_BLOCKS];
+	int p_free[LEASE_POOL_BLOCKS];  //stack of free block indices
+	int p_freeCount;
+	std::mutex p_lock;
+
+	//private methods
+private:
+	LeasePool(const LeasePool &);
+	LeasePool &operator=(const LeasePool &);
+};
+
+/** Allocator over a LeasePool, for std::shared_ptr( ptr, deleter, alloc ) */
+template<class T>
+class LeaseAllocator {
+public:
+	typedef T value_type;
+	LeasePool *pool;
+
+public:
+	LeaseAllocator(LeasePool *leasePool) : pool(leasePool) {}
+	template<class U>
+	LeaseAllocator(const LeaseAllocator<U> &other) : pool(other.pool) {}
+
+	T *allocate(size_t n)
+	{
+		static_assert(sizeof(T) <= LEASE_BLOCK_BYTES, "lease control block too big");
+		void *block = NULL;
+		if (n == 1)
+			block = pool->take();
+		if (block == NULL)
+			throw std::bad_alloc();
+		return static_cast<T *>(block);
+	}
+
+	void deallocate(T *p, size_t)
+	{
+		pool->give(p);
+	}
+};
+
+template<class T, class U>
+bool operator==(const LeaseAllocator<T> &a, const LeaseAllocator<U> &b)
+{
+	return a.pool == b.pool;
+}
+
+template<class T, class U>
+bool operator!=(const LeaseAllocator<T> &a, const LeaseAllocator<U> &b)
+{
+	return a.pool != b.pool;
+}
@@ -0,0 +1,125 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "MaskIntegral.hpp"
+
+#include <algorithm>
+
+/****************************** Definitions **********************************/
+
+//rectangles a trapezoid is split into (each as wide as its widest row)
+#define TRAPEZOID_STRIPS 4
+
+using std::min;
+using std::max;
+
+/****************************** Implementation *******************************/
+
+MaskIntegral::MaskIntegral( void )
+{
+	p_cols = 0;
+	p_rows = 0;
+	p_ready = false;
+}
+
+//Build the tables for this frame's masks
+void MaskIntegral::build( cv::Mat frameEdges, cv::Mat frameObstacles )
+{
+	p_cols = frameObstacles.cols;
+	p_rows = frameObstacles.rows;
+	build_table( frameObstacles, &p_obstacleSum );
+	build_table( frameEdges, &p_edgeSum );
+	p_ready = true;
+}
+
+//Mark the tables as out of date (the masks they were built from changed)
+void MaskIntegral::clear( void )
+{
+	p_ready = false;
+}
+
+int MaskIntegral::obstacles( cv::Rect r )
+{
+	return sum( p_obstacleSum, r );
+}
+
+int MaskIntegral::edges( cv::Rect r )
+{
+	return sum( p_edgeSum, r );
+}
+
+int MaskIntegral::obstacles_trapezoid( int cx, int yTop, int widthTop, int yBot, int widthBot )
+{
+	return trapezoid( p_obstacleSum, cx, yTop, widthTop, yBot, widthBot );
+}
+
+int MaskIntegral::edges_trapezoid( int cx, int yTop, int widthTop, int yBot, int widthBot )
+{
+	return trapezoid( p_edgeSum, cx, yTop, widthTop, yBot, widthBot );
+}
+
+//Each entry is the count of set pixels above and left of it
+void MaskIntegral::build_table( cv::Mat mask, std::vector<int> *table )
+{
+	int stride = p_cols + 1;
+	table->assign( stride * ( p_rows + 1 ), 0 );
+	int *t = &(*table)[0];
+
+	for( int y = 0; y < p_rows; y++ ) {
+		const uchar *row = mask.ptr<uchar>( y );
+		const int *above = &t[y * stride];
+		int *cur = &t[( y + 1 ) * stride];
+		int rowSum = 0;
+		for( int x = 0; x < p_cols; x++ ) {
+			rowSum += ( row[x] != 0 );
+			cur[x + 1] = above[x + 1] + rowSum;
+		}
+	}
+}
+
+int MaskIntegral::sum( const std::vector<int> &table, cv::Rect r )
+{
+	if( table.empty() )
+		return 0;
+
+	//clip to the frame
+	int x0 = max( r.x, 0 );
+	int y0 = max( r.y, 0 );
+	int x1 = min( r.x + r.width, p_cols );
+	int y1 = min( r.y + r.height, p_rows );
+	if( x0 >= x1 || y0 >= y1 )
+		return 0;
+
+	int stride = p_cols + 1;
+	return table[y1 * stride + x1] - table[y0 * stride + x1]
+		- table[y1 * stride + x0] + table[y0 * stride + x0];
+}
+
+//Cover the trapezoid with a few strips, each using the width of its widest
+//row, so the count can be a little high but never misses anything
+int MaskIntegral::trapezoid( const std::vector<int> &table, int cx, int yTop,
+		int widthTop, int yBot, int widthBot )
+{
+	int height = yBot - yTop + 1;
+	if( height <= 0 )
+		return 0;
+
+	int count = 0;
+	for( int s = 0; s < TRAPEZOID_STRIPS; s++ ) {
+		int top = yTop + ( height * s ) / TRAPEZOID_STRIPS;
+		int bot = yTop + ( height * ( s + 1 ) ) / TRAPEZOID_STRIPS;
+		if( bot <= top )
+			continue;
+		//widest row of this strip
+		int wTop = widthTop + ( ( widthBot - widthTop ) * ( top - yTop ) ) / height;
+		int wBot = widthTop + ( ( widthBot - widthTop ) * ( bot - yTop ) ) / height;
+		int w = max( wTop, wBot );
+		count += sum( table, cv::Rect( cx - w / 2, top, w, bot - top ) );
+	}
+	return count;
+}
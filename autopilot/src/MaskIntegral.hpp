@@ -0,0 +1,49 @@
+/******************************************************************************
+ * MaskIntegral Class - Summed area tables of the obstacle and edge masks.
+ *                      Counts how many obstacle or edge pixels are inside a
+ *                      rectangle with four lookups, and inside the wheel base
+ *                      trapezoid ahead of the truck with a few rectangles.
+ *                      Built per frame for the multi engine's corridor
+ *                      scores, where one table answers many queries.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+class MaskIntegral {
+	//methods
+public:
+	MaskIntegral();
+	void build(cv::Mat frameEdges, cv::Mat frameObstacles);
+	void clear(void);
+	bool ready(void) { return p_ready; }
+
+	//pixels set in a rectangle (clipped to the frame)
+	int obstacles(cv::Rect r);
+	int edges(cv::Rect r);
+	//pixels set in a trapezoid centered on cx, widthTop wide at row yTop and
+	//widthBot wide at row yBot
+	int obstacles_trapezoid(int cx, int yTop, int widthTop, int yBot, int widthBot);
+	int edges_trapezoid(int cx, int yTop, int widthTop, int yBot, int widthBot);
+
+	//private variables
+private:
+	int p_cols;
+	int p_rows;
+	bool p_ready;
+	std::vector<int> p_obstacleSum;  //(cols + 1) x (rows + 1), first row/col 0
+	std::vector<int> p_edgeSum;      //same layout
+
+	//private methods
+private:
+	int sum(const std::vector<int> &table, cv::Rect r);
+	int trapezoid(const std::vector<int> &table, int cx, int yTop, int widthTop,
+			int yBot, int widthBot);
+	void build_table(cv::Mat mask, std::vector<int> *table);
+};
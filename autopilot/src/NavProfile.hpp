@@ -0,0 +1,45 @@
+/******************************************************************************
+ * Navigate Profiles - Frame sizes the planner kernels are compiled for. With
+ *                     the size known at compile time the row scans get fixed
+ *                     bounds. Frames of any other size use NavProfileAny,
+ *                     which reads the size from the frame.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <vector>
+
+/****************************** Definitions **********************************/
+
+/** Frame size known at compile time (0 means read it from the frame) */
+template<int W, int H>
+struct NavProfile {
+	static const int cols = W;
+	static const int rows = H;
+
+	static bool matches(int frameCols, int frameRows)
+	{
+		return (W == 0 && H == 0) || (frameCols == W && frameRows == H);
+	}
+};
+
+/** Camera default */
+typedef NavProfile<160, 90> NavProfile160x90;
+/** Higher resolution camera mode */
+typedef NavProfile<320, 240> NavProfile320x240;
+/** Anything else */
+typedef NavProfile<0, 0> NavProfileAny;
+
+/** Per row tables built once for a frame size and set of parameters */
+typedef struct NAV_TABLES_S {
+	int cols;
+	int rows;
+	std::vector<int> weight;  //route weight by distance from bottom row
+	std::vector<int> minGap;  //narrowest gap the truck fits through, by y
+	int bailRow;              //can't-fit rows below this are close enough to bail
+	int halfRow;              //obstacles above this row are left for later
+} NAV_TABLES_T;
@@ -7,14 +7,21 @@
 /*************************** Include Files ***********************************/
 
 #include "Navigate.hpp"
+#include "TreeClassifier.hpp"
 
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
 /*************************** Definitions *************************************/
 
+//Default tuning values (see default_params, change at runtime through params)
+
 //steering
 #define EXP_FACTOR 0.06
 #define EXP_MULTIPLIER 9.0
@@ -40,6 +47,65 @@
 #define BAIL_DISTANCE_FACTOR_TO_BAIL 0.4
 #define BAIL_PORTION_BEFORE_TURN 0.7
 #define BAIL_CENTER_OFFSET 0.25
+//frames in a row before changing between forward and bail
+#define BAIL_FRAMES 5
+//truck width on the ground in meters (ground mode)
+#define TRUCK_WIDTH 0.25
+
+//obstacles (orange)
+#define OBSTACLE_HUE_CENTER 116 //lower is more orange
+#define OBSTACLE_HUE_RANGE 8
+#define OBSTACLE_SAT_MIN 175
+#define OBSTACLE_VAL_MIN 60
+#define OBSTACLE_VAL_MAX 255
+
+//course edges (blue)
+#define EDGE_HUE_CENTER 18
+#define EDGE_HUE_RANGE 14
+#define EDGE_SAT_MIN 100
+#define EDGE_VAL_MIN 50
+#define EDGE_VAL_MAX 255
+
+//planning
+//rows skipped by the coarse pass when planning on a time budget
+#define PLAN_COARSE_STEP 4
+
+//pyramid (only for frames at least this wide)
+#define PYRAMID_MIN_COLS 320
+//portion of rows at the top classified at full resolution
+#define PYRAMID_FAR_PORTION 0.5
+//row step when walking near rows (they're classified at half resolution)
+#define PYRAMID_NEAR_STEP 2
+
+//multi-hypothesis route search
+//start columns as a portion of the width from center
+#define MULTI_START_OFFSETS { 0.0f, -0.17f, 0.17f }
+//lean inside each gap as a portion of the width
+#define MULTI_BIASES { 0.0f, -0.03f, 0.03f }
+//score per pixel of average room beyond what the truck needs
+#define MULTI_CLEARANCE_WEIGHT 0.5
+//score lost by routes that end in a bail
+#define MULTI_BAIL_PENALTY 1000.0
+//score lost by a route whose wheel base corridor is all obstacle
+#define MULTI_CORRIDOR_PENALTY 50.0
+
+//edge model
+//widest run of edge pixels (full size columns) the walk treats as a stray
+//speck inside the fitted course instead of a course edge
+#define EDGE_STRAY_MAX_RUN 3
+
+//stationary scene detection
+//size of the signature frames are compared by
+#define SKIP_SIG_COLS 16
+#define SKIP_SIG_ROWS 9
+//a signature cell changing more than this (0-255) means the scene moved
+#define SKIP_CELL_DIFF 12
+//frames in a row that can be skipped before one is analyzed anyway
+#define SKIP_MAX_STREAK 4
+
+//classification bands (when classifying on worker threads)
+#define BANDS_PER_WORKER 2
+#define BAND_MIN_ROWS 8
 
 #define WRITE_VIDEO_NAME "video_navigate.avi"
 #define VIDEO_RATE 30
@@ -49,27 +115,145 @@ using std::endl;
 using std::string;
 using namespace cv;
 
-typedef enum EDGE_TYPE_E {
-	EDGE_TYPE_EDGE = 0,
-	EDGE_TYPE_OBJECT,
-	EDGE_TYPE_IMG
-} EDGE_TYPE_T;
-
 /*************************** Implementation **********************************/
 
 Navigate::Navigate( void )
 {
-	namedWindow("main", CV_WINDOW_KEEPRATIO);
-	cout << "Creating Navigate Object!" << endl;
+	init( default_params() );
+}
+
+Navigate::Navigate( const NAV_PARAMS_T &navParams )
+{
+	init( navParams );
+}
+
+Navigate::~Navigate( void )
+{
+	if( p_lutThread.joinable() )
+		p_lutThread.join();
+}
+
+void Navigate::init( const NAV_PARAMS_T &navParams )
+{
+	params = navParams;
+	p_navState = NAV_STATE_FORWARD;
+	p_bailState = NAV_BAIL_STATE_BACKUP;
+	p_bail = false;
+	p_bailToTheRight = false;
+	speed = 0;
+	direction = 0;
+	verbose = true;
 	p_bailCnt = 0;
 	debugMode = false;
 	showObjects = false;
 	showEdges = false;
 	p_writeVideo = false;
+	writeVideoVerbose = false;
+	planBudgetUs = 0;
+	planRowsRefined = 0;
+	planRowsTotal = 0;
+	planComplete = true;
+	pyramidMode = false;
+	routeEngine = NAV_ENGINE_GREEDY;
+	temporalMode = false;
+	cacheRowsHit = 0;
+	cacheRowsScanned = 0;
+	skipMode = false;
+	clearanceMode = false;
+	integralMode = false;
+	groundMode = false;
+	groundCamera = GroundMap::default_camera();
+	p_tableGround = false;
+	occupancyMode = false;
+	blobMode = false;
+	edgeModelMode = false;
+	treeMode = false;
+	lutMode = false;
+	lutBuilds = 0;
+	p_lutDirty = false;
+	p_lutBuilding = false;
+	p_bailBlob = -1;
+	p_lastFrameTick = 0;
+	framesAnalyzed = 0;
+	framesSkipped = 0;
+	p_skipStreak = 0;
+	planHypothesis = 0;
+	p_nearRow = 0;
+	p_nearStep = 1;
+	p_readyRow = 0;
+	p_bandsReady = 0;
+	p_tables.cols = 0;
+	p_tables.rows = 0;
+}
+
+NAV_PARAMS_T Navigate::default_params( void )
+{
+	NAV_PARAMS_T p;
+
+	//steering
+	p.expFactor = EXP_FACTOR;
+	p.expMultiplier = EXP_MULTIPLIER;
+	p.steeringSensitivity = STEERING_SENSITIVITY;
+	p.objInRowMultiplier = OBJ_IN_ROW_MULTIPLIER;
+
+	//speed
+	p.speedDistFromCenter = SPEED_DIST_FROM_CENTER;
+	p.speedDist0 = SPEED_DIST0;
+	p.speedDist1 = SPEED_DIST1;
+	p.speedDist2 = SPEED_DIST2;
+	p.speedVal0 = SPEED_VAL0;
+	p.speedVal1 = SPEED_VAL1;
+	p.speedVal2 = SPEED_VAL2;
+	p.speedVal3 = SPEED_VAL3;
+	p.speedValBak = SPEED_VAL_BAK;
+	p.speedFactor = SPEED_FACTOR;
+
+	//bailing
+	p.bailDistanceFactor = BAIL_DISTANCE_FACTOR_TO_BAIL;
+	p.bailPortionBeforeTurn = BAIL_PORTION_BEFORE_TURN;
+	p.bailCenterOffset = BAIL_CENTER_OFFSET;
+	p.bailFrames = BAIL_FRAMES;
+
+	//obstacles
+	p.obstacleHueCenter = OBSTACLE_HUE_CENTER;
+	p.obstacleHueRange = OBSTACLE_HUE_RANGE;
+	p.obstacleSatMin = OBSTACLE_SAT_MIN;
+	p.obstacleValMin = OBSTACLE_VAL_MIN;
+	p.obstacleValMax = OBSTACLE_VAL_MAX;
+
+	//edges
+	p.edgeHueCenter = EDGE_HUE_CENTER;
+	p.edgeHueRange = EDGE_HUE_RANGE;
+	p.edgeSatMin = EDGE_SAT_MIN;
+	p.edgeValMin = EDGE_VAL_MIN;
+	p.edgeValMax = EDGE_VAL_MAX;
+
+	return p;
+}
+
+bool Navigate::is_bailing( void )
+{
+	return ( p_navState == NAV_STATE_BAIL );
 }
 
 void Navigate::analyze_frame(cv::Mat frame)
 {
+	//move the map by what we told the truck to do since the last frame
+	if (occupancyMode) {
+		int64 now = getTickCount();
+		if (p_lastFrameTick != 0)
+			p_occupancy.move_commanded(speed, direction,
+					(double)(now - p_lastFrameTick) / getTickFrequency());
+		p_lastFrameTick = now;
+	}
+
+	//nothing has changed since the last frame we analyzed, keep its decision
+	if (skipMode && scene_unchanged(frame)) {
+		framesSkipped++;
+		return;
+	}
+	framesAnalyzed++;
+
 	switch (p_navState) {
 	case NAV_STATE_FORWARD:
 		//analyze frame
@@ -77,15 +261,19 @@ void Navigate::analyze_frame(cv::Mat frame)
 		//check if it wants us to bail
 		if (p_bail) {
 			p_bailCnt++;
-			cout << "BailCnt: " << p_bailCnt << endl;
-			//check if we wanted to bail 5 times in a row
-			if (p_bailCnt == 5) {
-				cout << "Changing to bail state." << endl;
+			if (verbose)
+				cout << "BailCnt: " << p_bailCnt << endl;
+			//check if we wanted to bail 5 times in a row (a tracked cone
+			//has already been seen that long)
+			if (p_bailCnt == params.bailFrames || (blobMode && p_bailBlob >= 0)) {
+				if (verbose)
+					cout << "Changing to bail state." << endl;
 				p_bailCnt = 0;
 				p_navState = NAV_STATE_BAIL;
 			}
 		}
-		else {
+		else if (!(blobMode && p_bailBlob >= 0)) {
+			//a tracked cone still in the way doesn't reset the count
 			p_bailCnt = 0;
 		}
 		break;
@@ -96,10 +284,12 @@ void Navigate::analyze_frame(cv::Mat frame)
 		//check if it wants us to bail
 		if (!p_bail) {
 			p_bailCnt++;
-			cout << "BailCnt: " << p_bailCnt << endl;
+			if (verbose)
+				cout << "BailCnt: " << p_bailCnt << endl;
 			//check if we wanted to bail 5 times in a row
-			if (p_bailCnt == 5) {
-				cout << "Changing to forward state." << endl;
+			if (p_bailCnt == params.bailFrames) {
+				if (verbose)
+					cout << "Changing to forward state." << endl;
 				p_bailCnt = 0;
 				p_navState = NAV_STATE_FORWARD;
 			}
@@ -111,88 +301,412 @@ void Navigate::analyze_frame(cv::Mat frame)
 	}
 }
 
+//Compare a tiny copy of the frame against the one from the last analyzed
+//frame. Returns true when no cell changed enough to matter and we haven't
+//skipped too many frames in a row already. Recorded frames are never skipped.
+bool Navigate::scene_unchanged(cv::Mat frame)
+{
+	//(a YUYV frame's U and V get averaged together, still fine for spotting change)
+	Mat sig;
+	resize(frame, sig, Size(SKIP_SIG_COLS, SKIP_SIG_ROWS), 0, 0, INTER_AREA);
+
+	if (!p_writeVideo && p_skipStreak < SKIP_MAX_STREAK &&
+			p_sceneSig.size() == sig.size() && p_sceneSig.type() == sig.type()) {
+		//biggest change in any cell and channel
+		Mat diff;
+		double maxDiff;
+		absdiff(sig, p_sceneSig, diff);
+		minMaxLoc(diff.reshape(1), NULL, &maxDiff);
+		if (maxDiff <= SKIP_CELL_DIFF) {
+			p_skipStreak++;
+			return true;
+		}
+	}
+
+	//this frame gets analyzed, later frames are compared against it
+	sig.copyTo(p_sceneSig);
+	p_skipStreak = 0;
+	return false;
+}
+
+//Bail turn check from the tracked cones: we've turned enough once the cone
+//we bailed for is off to the side we're turning away from, by more than
+//centerOffset, or its track has been dropped. A bail the route started
+//(no cone in front) follows the nearest cone seen once turning. Straight
+//into the cone (or none seen yet) keeps us turning.
+bool Navigate::turned_past_blob(int center, int centerOffset)
+{
+	if (p_bailBlob < 0) {
+		const BLOB_T *nearest = p_tracker.nearest();
+		if (nearest == NULL)
+			return false;
+		p_bailBlob = nearest->id;
+	}
+
+	//gone for longer than the tracker waits out mask flicker
+	const BLOB_T *b = p_tracker.find(p_bailBlob);
+	if (b == NULL)
+		return true;
+
+	int left = b->box.x;
+	int right = b->box.x + b->box.width - 1;
+	if (p_bailToTheRight)
+		return (right < center && center - right > centerOffset);
+	return (left > center && left - center > centerOffset);
+}
+
+//Check the map for obstacles between the bumper and the bottom of the
+//camera's view, straight ahead and as wide as the truck. Always clear when
+//we aren't keeping a map.
+bool Navigate::blind_spot_clear(int cols, int rows)
+{
+	if (!occupancyMode || !groundMode)
+		return true;
+
+	build_tables(cols, rows);
+	float nearest = p_ground.to_ground(cols / 2, rows - 1).y;
+	if (nearest <= 0)
+		return true;
+
+	int remembered = p_occupancy.obstacles_in(-TRUCK_WIDTH / 2, TRUCK_WIDTH / 2, 0, nearest);
+	if (remembered > 0 && verbose)
+		cout << "Obstacle remembered in front of the bumper" << endl;
+	return (remembered == 0);
+}
+
 //Notes:
 //Wheel base:	1/6 width from edge of frame at bottom (1/8)
 //				1/6 width of frame at top of frame (1/5)
 void Navigate::analyze_forward(cv::Mat frame)
 {
-	//convert frame to HSV Color Space
-	cv::Mat colors;
-	cvtColor(frame, colors, CV_RGB2HSV);
+	//the planning budget counts from when we got the frame
+	int64 startTick = getTickCount();
 
 	//get obstacle and edge images
 	Mat frameObstacles;
 	Mat frameEdges;
-	get_obstacles(colors, &frameObstacles);
-	get_edges(colors, &frameEdges);
+	classify(frame, &frameObstacles, &frameEdges);
 
 	//blend the two together
 	//cv::bitwise_not(frameEdges | frameObstacles, combined);
 	//create debug img
 	//cv::cvtColor(frameEdges, p_debugImg, CV_GRAY2BGR);
 	//cv::cvtColor((frameEdges | frameObstacles), p_debugImg, CV_GRAY2BGR);
-	frame.copyTo(p_debugImg);
+	debug_frame(frame);
+
+	//bird's eye view of the masks
+	if (groundMode) {
+		wait_rows(0);
+		build_tables(frameEdges.cols, frameEdges.rows);
+		p_ground.warp(frameEdges, frameObstacles, &groundView);
+		if (occupancyMode)
+			p_occupancy.update(groundView, groundCamera);
+	}
+
+	//gap lookups for the walks instead of scanning rows (the cost map engine
+	//does its own)
+	p_clearance.clear();
+	if (clearanceMode && routeEngine != NAV_ENGINE_DP) {
+		wait_rows(0);
+		p_clearance.build(frameEdges, frameObstacles);
+	}
+
+	//area counts for scoring routes
+	p_integral.clear();
+	if (integralMode && routeEngine == NAV_ENGINE_MULTI) {
+		wait_rows(0);
+		p_integral.build(frameEdges, frameObstacles);
+	}
 
 	//find best route in image
 	int midPoint = frameEdges.cols / 2;
-	std::vector<int> route;
-	std::vector<bool> objInRow;
+	NAV_ROUTE_T route;
+	//last frame's gaps to start from (not with a clearance map, every gap
+	//is already a lookup)
+	const NAV_ROUTE_T *prev = NULL;
+	if (temporalMode && !p_clearance.ready())
+		prev = &p_prevRoute;
+	if (routeEngine == NAV_ENGINE_MULTI) {
+		//several routes at once, keep the best
+		int64 deadline = 0;
+		if (planBudgetUs > 0)
+			deadline = startTick +
+				(int64)(((double)planBudgetUs * getTickFrequency()) / 1000000.0);
+		plan_multi(frameEdges, frameObstacles, deadline, &route);
+		planRowsRefined = (int)route.x.size();
+	}
+	else if (routeEngine == NAV_ENGINE_DP) {
+		//cheapest path through a cost map of the whole frame
+		plan_dp(frameEdges, frameObstacles, &route);
+		planRowsRefined = (int)route.x.size();
+	}
+	else if (planBudgetUs > 0) {
+		int64 deadline = startTick +
+			(int64)(((double)planBudgetUs * getTickFrequency()) / 1000000.0);
+
+		//refine every row until we run out of time (waiting on bands counts),
+		//picking up bottom bands as they finish
+		walk_route(frameEdges, frameObstacles, 1, -1, 0, deadline, prev, &route, &p_debugImg);
+		planRowsRefined = (int)route.x.size();
+		if (!route.complete) {
+			//out of time, finish the route with a coarse pass over the rows
+			//that are classified by now (it never waits)
+			NAV_ROUTE_T coarse;
+			walk_route(frameEdges, frameObstacles, PLAN_COARSE_STEP, -1, 0, NAV_DEADLINE_READY,
+					NULL, &coarse, NULL);
+			for (int i = (int)route.x.size(); i < (int)coarse.x.size(); i++) {
+				route.x.push_back(coarse.x.at(i));
+				route.objInRow.push_back(coarse.objInRow.at(i));
+			}
+			route.bail = coarse.bail;
+			route.bailToTheRight = coarse.bailToTheRight;
+			if (verbose)
+				cout << "Planning out of time, refined " << planRowsRefined
+					<< " of " << route.x.size() << " rows" << endl;
+		}
+	}
+	else {
+		walk_route(frameEdges, frameObstacles, 1, -1, 0, 0, prev, &route, &p_debugImg);
+		planRowsRefined = (int)route.x.size();
+	}
+	//let classification of any rows the walk didn't need finish
+	classify_wait();
+
+	//fit the course edges for the next frame's walk, warm started from this
+	//fit (fitting before the walk would wait for every band)
+	if (edgeModelMode)
+		p_edgeModel.update(frameEdges);
+
+	//follow the cones, note one close in front of the truck
+	p_bailBlob = -1;
+	if (blobMode) {
+		p_tracker.update(frameObstacles);
+		int halfWidth = p_tables.minGap[frameObstacles.rows - 1] / 2;
+		const BLOB_T *b = p_tracker.nearest_in(midPoint - halfWidth, midPoint + halfWidth,
+				p_tables.bailRow);
+		if (b != NULL)
+			p_bailBlob = b->id;
+	}
+
+	//keep this route's gaps for the next frame
+	if (temporalMode)
+		p_prevRoute = route;
+
+	planRowsTotal = (int)route.x.size();
+	planComplete = route.complete;
+
+	//set bail direction and state
+	if (route.bail) {
+		p_bailToTheRight = route.bailToTheRight;
+		p_bailState = NAV_BAIL_STATE_BACKUP;
+	}
+
+	//look at route and determine current direction and speed
+	int nextSpeed;
+	int nextDirection;
+	route_decision(route, midPoint, &nextSpeed, &nextDirection);
+
+	//set speed, direction, and bail values
+	speed = nextSpeed;
+	direction = nextDirection;
+	p_bail = route.bail;
+
+	//draw steering text on screen
+	std::string pSteering = "Direction: ";
+	pSteering.append( std::to_string( direction ) );
+	putText(p_debugImg, pSteering, Point(10, 10), FONT_HERSHEY_PLAIN, 1, CV_RGB(255, 0, 0), 1);
+
+	//draw drive text on screen
+	std::string pDrive= "Speed    : ";
+	pDrive.append( std::to_string( speed ) );
+	putText(p_debugImg, pDrive, Point(10, 30), FONT_HERSHEY_PLAIN, 1, CV_RGB(255, 0, 0), 1);
+
+	//show debug image
+	if( debugMode )
+		imshow("main", p_debugImg);
+	if( p_writeVideo && p_debugImg.size() == p_videoSize ) {
+		cout << "writing frame to video... " << p_debugImg.size() << endl;
+		p_video << p_debugImg;
+		cout << "frame complete... " << endl;
+	}
+	else if( p_writeVideo && p_debugImg.size() != p_videoSize)
+		cout << "Weird, frame came in differently..." << endl;
+}
+
+//Walk up the image from the bottom center, following the middle of the gap
+//we can drive through. Only every step'th row is looked at (the rows in
+//between repeat the last target), and near rows from the pyramid are walked
+//at their own step on the half size masks. Stops early once the deadline tick is
+//passed, waiting for rows still being classified counts (0 for no deadline,
+//NAV_DEADLINE_READY to walk only rows already classified). startX picks another starting column (-1 for
+//the center) and bias leans the target that many pixels inside each gap.
+//Gaps come from the clearance map when one was built for this frame,
+//otherwise gaps from a previous route (prev, NULL for none) are reused for
+//rows where they still hold instead of scanning the row again. Debug drawing only
+//happens when a debug image is given, messages only when we're also verbose.
+void Navigate::walk_route(cv::Mat frameEdges, cv::Mat frameObstacles, int step,
+		int startX, int bias, int64 deadline, const NAV_ROUTE_T *prev,
+		NAV_ROUTE_T *route, cv::Mat *debugImg)
+{
+	build_tables(frameEdges.cols, frameEdges.rows);
+
+	//use the kernel compiled for this frame size if we have one
+	if (NavProfile160x90::matches(frameEdges.cols, frameEdges.rows))
+		walk_route_kernel<NavProfile160x90>(frameEdges, frameObstacles, step,
+				startX, bias, deadline, prev, route, debugImg);
+	else if (NavProfile320x240::matches(frameEdges.cols, frameEdges.rows))
+		walk_route_kernel<NavProfile320x240>(frameEdges, frameObstacles, step,
+				startX, bias, deadline, prev, route, debugImg);
+	else
+		walk_route_kernel<NavProfileAny>(frameEdges, frameObstacles, step,
+				startX, bias, deadline, prev, route, debugImg);
+}
+
+template<class P>
+void Navigate::walk_route_kernel(cv::Mat frameEdges, cv::Mat frameObstacles,
+		int step, int startX, int bias, int64 deadline, const NAV_ROUTE_T *prev,
+		NAV_ROUTE_T *route, cv::Mat *debugImg)
+{
+	//compile time size when the profile has one
+	const int cols = P::cols ? P::cols : frameEdges.cols;
+	const int rows = P::rows ? P::rows : frameEdges.rows;
+	const int *minGap = &p_tables.minGap[0];
+	int midPoint = cols / 2;
 	int prevX = midPoint;
 	int y;
-	bool nextBail = false;
-	for ( y = frameEdges.rows - 1; y >= 0; y--) {
-		int targetX = prevX;
+
+	if (startX >= 0 && startX < cols)
+		prevX = startX;
+
+	route->x.clear();
+	route->objInRow.clear();
+	route->bail = false;
+	route->bailToTheRight = false;
+	route->complete = true;
+	route->clearance = 0;
+	route->gapL.assign(rows, -1);
+	route->gapR.assign(rows, -1);
+
+	//previous gaps are only any use for the same size frame
+	if (prev != NULL && (int)prev->gapL.size() != rows)
+		prev = NULL;
+
+	//look gaps up instead of scanning for them
+	bool useMap = p_clearance.ready();
+	if (useMap)
+		prev = NULL;
+
+	//near rows classified at half resolution are walked on the small masks
+	bool useNear = (!useMap && !p_nearEdges.empty());
+
+	int rowStep = step;
+	int readyRow = ready_row();
+	for ( y = rows - 1; y >= 0; y -= rowStep) {
+		//wait for this row if it's still being classified (not past the
+		//deadline)
+		if (y < readyRow && deadline != NAV_DEADLINE_READY)
+			readyRow = wait_rows_until(y, deadline);
+		if (y < readyRow) {
+			route->complete = false;
+			break;
+		}
+
+		//rows classified at low resolution don't need every row walked
+		rowStep = step;
+		if (y >= p_nearRow && p_nearStep > step)
+			rowStep = p_nearStep;
+
+		//check if we're out of time
+		if (deadline > 0 && getTickCount() > deadline) {
+			route->complete = false;
+			break;
+		}
+
+		//sx full size columns per column of the row we walk (pyrDown halves)
+		const uchar *edgeRow = frameEdges.ptr<uchar>(y);
+		const uchar *obsRow = frameObstacles.ptr<uchar>(y);
+		int sx = 1;
+		int rowCols = cols;
+		if (useNear && y >= p_nearRow) {
+			int nearY = std::min((y - p_nearRow) / 2, p_nearEdges.rows - 1);
+			edgeRow = p_nearEdges.ptr<uchar>(nearY);
+			obsRow = p_nearObstacles.ptr<uchar>(nearY);
+			sx = 2;
+			rowCols = p_nearEdges.cols;
+		}
+		int x = std::min(prevX / sx, rowCols - 1);
+		int rowGap = minGap[y] / sx;
+		int targetX = x;
 		bool objInThisRow = false;
 		//ensure we're not at an edge 
-		if (frameEdges.at<uchar>(Point(prevX, y)) == 0) {
+		if (edgeRow[x] == 0) {
 			//check that we're not at an obstacle
-			if (frameObstacles.at<uchar>(Point(prevX, y)) == 0) {
+			if (obsRow[x] == 0) {
 				//find first edge point in both directions
-				int edgeL = prevX;
-				int edgeR = prevX;
-				while (edgeL > 0 &&
-					frameEdges.at<uchar>(Point(edgeL, y)) == 0 &&
-					frameObstacles.at<uchar>(Point(edgeL, y)) == 0) {
-					p_debugImg.at<Vec3b>(Point(edgeL, y)) = Vec3b(255, 0, 255);
-					edgeL--;
+				int edgeL = x;
+				int edgeR = x;
+				if (useMap) {
+					edgeL = p_clearance.left(prevX, y);
+					edgeR = p_clearance.right(prevX, y);
 				}
-					if( writeVideoVerbose && p_writeVideo && 
-							p_debugImg.size() == p_videoSize ) {
-						cout << "'";
-						p_video << p_debugImg;
-					}
-				while (edgeR < (frameEdges.cols - 1) &&
-					frameEdges.at<uchar>(Point(edgeR, y)) == 0 &&
-					frameObstacles.at<uchar>(Point(edgeR, y)) == 0) {
-					p_debugImg.at<Vec3b>(Point(edgeR, y)) = Vec3b(255, 255, 0);
-					edgeR++;
+				else if (prev != NULL && gap_holds(prev->gapL[y] / sx, prev->gapR[y] / sx,
+							x, rowCols, edgeRow, obsRow)) {
+					//last frame's gap is still good
+					edgeL = prev->gapL[y] / sx;
+					edgeR = prev->gapR[y] / sx;
+					cacheRowsHit++;
 				}
-					if( writeVideoVerbose && p_writeVideo && 
-							p_debugImg.size() == p_videoSize ) {
-						cout << ".";
-						p_video << p_debugImg;
+				else {
+					if (prev != NULL)
+						cacheRowsScanned++;
+					while (edgeL > 0 &&
+						edgeRow[edgeL] == 0 &&
+						obsRow[edgeL] == 0) {
+						if (debugImg)
+							debugImg->at<Vec3b>(Point(edgeL * sx, y)) = Vec3b(255, 0, 255);
+						edgeL--;
 					}
+						if( debugImg && writeVideoVerbose && p_writeVideo && 
+								debugImg->size() == p_videoSize ) {
+							cout << "'";
+							p_video << *debugImg;
+						}
+					while (edgeR < (rowCols - 1) &&
+						edgeRow[edgeR] == 0 &&
+						obsRow[edgeR] == 0) {
+						if (debugImg)
+							debugImg->at<Vec3b>(Point(edgeR * sx, y)) = Vec3b(255, 255, 0);
+						edgeR++;
+					}
+						if( debugImg && writeVideoVerbose && p_writeVideo && 
+								debugImg->size() == p_videoSize ) {
+							cout << ".";
+							p_video << *debugImg;
+						}
+				}
+				route->gapL[y] = edgeL * sx;
+				route->gapR[y] = edgeR * sx + sx - 1;
 
 				//classify edge types and weight accordingly
 				EDGE_TYPE_T edgeLType = EDGE_TYPE_IMG;
 				EDGE_TYPE_T edgeRType = EDGE_TYPE_IMG;
 				float lWeight = 10.0;
 				float rWeight = 10.0;
-				if (frameObstacles.at<uchar>(Point(edgeL, y)) != 0) {
+				if (obsRow[edgeL] != 0) {
 					lWeight = 6.0;
 					edgeLType = EDGE_TYPE_OBJECT;
 					objInThisRow = true;
 				}
-				else if (frameEdges.at<uchar>(Point(edgeL, y)) != 0) {
+				else if (edgeRow[edgeL] != 0) {
 					lWeight = 9.0;
 					edgeLType = EDGE_TYPE_EDGE;
 				}
-				if (frameObstacles.at<uchar>(Point(edgeR, y)) != 0) {
+				if (obsRow[edgeR] != 0) {
 					rWeight = 7.0;
 					edgeRType = EDGE_TYPE_OBJECT;
 					objInThisRow = true;
 				}
-				else if (frameEdges.at<uchar>(Point(edgeR, y)) != 0) {
+				else if (edgeRow[edgeR] != 0) {
 					rWeight = 9.0;
 					edgeRType = EDGE_TYPE_EDGE;
 				}
@@ -202,44 +716,35 @@ void Navigate::analyze_forward(cv::Mat frame)
 				//printf( "weighted edge ((l+r)/w): ((%f * %d) + (%f * %d))/(%f + %f)\n",
 					//lWeight, edgeL, rWeight, edgeR, rWeight, lWeight);
 
+				//lean the route the way this hypothesis wants
+				if (bias != 0) {
+					targetX += bias / sx;
+					if (targetX <= edgeL)
+						targetX = edgeL + 1;
+					else if (targetX >= edgeR)
+						targetX = edgeR - 1;
+				}
+
 				//check if our car doesn't fit through here
 				int gapSize = edgeR - edgeL;
-				if (gapSize < get_min_dist(y) && y != frameEdges.rows - 1) {
+				route->clearance += (gapSize - rowGap) * sx * rowStep;
+				if (gapSize < rowGap && y != rows - 1) {
 					//gap is too small, check if we're between and edge and an object
 					if ((edgeLType == EDGE_TYPE_EDGE && edgeRType == EDGE_TYPE_OBJECT) ||
 						(edgeLType == EDGE_TYPE_OBJECT && edgeRType == EDGE_TYPE_EDGE)) {
-#if 0
-						//lets flip everything on this side of the image to the other side of the image
-						//are we currently on the right?
-						bool rightSide = true;;
-						if (targetX < midPoint)
-							rightSide = false;
-						//flip everything until the route wasn't on this side
-						for (int i = route.size() - 1; i >= 0; i--) {
-							//check if we got back to the midpoint
-							if (rightSide && route.at(i) < midPoint)
-								break;
-							else if (!rightSide && route.at(i) > midPoint)
-								break;
-
-							route.at(i) = 2 * midPoint - route.at(i);
-							p_debugImg.at<Vec3b>(Point(route.at(i), frameEdges.rows - 1 - i)) = Vec3b(0, 255, 255);
-						}
-#endif
 						//only bail if we're at least somewhat close to the object
-						cout << "Cannot fit between edge and object at " << y << endl;
-						if (y > (int)((float)frameEdges.rows * BAIL_DISTANCE_FACTOR_TO_BAIL ) ) {
+						if (debugImg && verbose)
+							cout << "Cannot fit between edge and object at " << y << endl;
+						if (y > p_tables.bailRow) {
 							//OK, it's close. We should bail.
-							nextBail = true;
+							route->bail = true;
 							//set bail direction
 							if (edgeLType == EDGE_TYPE_EDGE && edgeRType == EDGE_TYPE_OBJECT)
-								p_bailToTheRight = true;
+								route->bailToTheRight = true;
 							else
-								p_bailToTheRight = false;
-							//set bail state
-							p_bailState = NAV_BAIL_STATE_BACKUP;
+								route->bailToTheRight = false;
 						}
-						else {
+						else if (debugImg && verbose) {
 							cout << "Not close enough to bail." << endl;
 						}
 
@@ -263,56 +768,54 @@ void Navigate::analyze_forward(cv::Mat frame)
 			//we ran straight into an obstacle, do something
 			else {
 				//if not within the first 1/2 of image, we really don't care
-				if (y > frame.rows / 2) {
+				if (y > p_tables.halfRow) {
 					//find first edge point in both directions
-					int edgeL = prevX;
-					int edgeR = prevX;
+					int edgeL = x;
+					int edgeR = x;
 					while (edgeL > 0 &&
-						frameEdges.at<uchar>(Point(edgeL, y)) == 0) {
-						p_debugImg.at<Vec3b>(Point(edgeL, y)) = Vec3b(0, 255, 255);
+						edgeRow[edgeL] == 0) {
+						if (debugImg)
+							debugImg->at<Vec3b>(Point(edgeL * sx, y)) = Vec3b(0, 255, 255);
 						edgeL--;
 					}
-					while (edgeR < (frameEdges.cols - 1) &&
-						frameEdges.at<uchar>(Point(edgeR, y)) == 0) {
-						p_debugImg.at<Vec3b>(Point(edgeR, y)) = Vec3b(0, 255, 0);
+					while (edgeR < (rowCols - 1) &&
+						edgeRow[edgeR] == 0) {
+						if (debugImg)
+							debugImg->at<Vec3b>(Point(edgeR * sx, y)) = Vec3b(0, 255, 0);
 						edgeR++;
 					}
 
 					//classify edge types and weight accordingly
 					EDGE_TYPE_T edgeLType = EDGE_TYPE_IMG;
 					EDGE_TYPE_T edgeRType = EDGE_TYPE_IMG;
-					float lWeight = 10.0;
-					float rWeight = 10.0;
-					if (frameEdges.at<uchar>(Point(edgeL, y)) != 0) {
-						lWeight = 9.0;
+					if (edgeRow[edgeL] != 0)
 						edgeLType = EDGE_TYPE_EDGE;
-					}
-					if (frameEdges.at<uchar>(Point(edgeR, y)) != 0) {
-						rWeight = 9.0;
+					if (edgeRow[edgeR] != 0)
 						edgeRType = EDGE_TYPE_EDGE;
-					}
 
 					//is course edge only on the left
 					if (edgeLType == EDGE_TYPE_EDGE &&
 						edgeRType == EDGE_TYPE_IMG)
 						//go halfway between object and edge of picture
-						targetX = (prevX + (frame.cols - 1)) / 2;
+						targetX = (x + (rowCols - 1)) / 2;
 					//is course edge only on the right
 					else if (edgeLType == EDGE_TYPE_IMG &&
 						edgeRType == EDGE_TYPE_EDGE)
 						//go halfway between object and edge of picture
-						targetX = prevX / 2;
+						targetX = x / 2;
 					//is course edge further away on the right
-					else if ((edgeR - prevX) > (prevX - edgeL))
+					else if ((edgeR - x) > (x - edgeL))
 						//go halfway between object and edge
-						targetX = (edgeR + prevX) / 2;
+						targetX = (edgeR + x) / 2;
 					//is course edge further away on the left
 					else
 						//go halfway between object and edge
-						targetX = (edgeL + prevX) / 2;
+						targetX = (edgeL + x) / 2;
 
-					p_debugImg.at<Vec3b>(Point(targetX, y)) = Vec3b(255, 255, 255);
-					cout << "Ran straight into obstacle at ." << y << endl;
+					if (debugImg)
+						debugImg->at<Vec3b>(Point(targetX * sx, y)) = Vec3b(255, 255, 255);
+					if (debugImg && verbose)
+						cout << "Ran straight into obstacle at ." << y << endl;
 				}
 				//not within first half of image,
 				else {
@@ -323,101 +826,287 @@ void Navigate::analyze_forward(cv::Mat frame)
 				}
 			}
 		}
+		//the fitted course edges say this is a stray edge pixel inside the
+		//course (a short run with free pixels over to the middle of the
+		//course), keep going down the middle of it
+		else if (edgeModelMode && p_edgeModel.covers(prevX, y, minGap[y]) &&
+				stray_edge(edgeRow, obsRow, x,
+					std::min(std::max(p_edgeModel.center_at(y) / sx, 0), rowCols - 1),
+					std::max(EDGE_STRAY_MAX_RUN / sx, 1), rowCols)) {
+			targetX = std::min(std::max(p_edgeModel.center_at(y) / sx, 0), rowCols - 1);
+			if (debugImg && verbose)
+				cout << "Stray edge pixel inside the course at " << Point(prevX, y) << endl;
+		}
 		//we ran straight into an edge here, just end. Next frame will have more information
 		else {
-			cout << "Ran straight into an edge. Waiting for new frame. " << Point(prevX, y) << endl;
+			if (debugImg && verbose)
+				cout << "Ran straight into an edge. Waiting for new frame. " << Point(prevX, y) << endl;
 			break;
 		}
 
-		//add next x to route
-		p_debugImg.at<Vec3b>(Point(targetX, y)) = Vec3b(0, 255, 255);
-		route.push_back( targetX );
-		objInRow.push_back(objInThisRow);
+		//back to full size columns (an unchanged target stays where it was)
+		if (targetX == x)
+			targetX = prevX;
+		else
+			targetX = std::min(targetX * sx + sx / 2, cols - 1);
+
+		//add next x to route (once for every row this step covers)
+		if (debugImg)
+			debugImg->at<Vec3b>(Point(targetX, y)) = Vec3b(0, 255, 255);
+		for (int i = 0; i < rowStep && y - i >= 0; i++) {
+			route->x.push_back( targetX );
+			route->objInRow.push_back(objInThisRow);
+		}
 
 		//push previous point onto route
 		prevX = targetX;
 	}
+}
+
+//Check that a gap from the last frame is still what a scan from x would
+//find: both ends still stop a scan and every pixel inside is still free. The
+//inside is checked eight pixels at a time, it's still cheaper than the scan
+//because there's no per pixel branch.
+bool Navigate::gap_holds(int edgeL, int edgeR, int x, int cols,
+		const uchar *edgeRow, const uchar *obsRow)
+{
+	if (edgeL < 0 || edgeL >= x || edgeR <= x || edgeR >= cols)
+		return false;
+
+	//ends have to be blocked, or the image border
+	if (edgeL != 0 && (edgeRow[edgeL] | obsRow[edgeL]) == 0)
+		return false;
+	if (edgeR != cols - 1 && (edgeRow[edgeR] | obsRow[edgeR]) == 0)
+		return false;
+
+	//inside has to be free
+	int i = edgeL + 1;
+	uint64_t blocked = 0;
+	for (; i + 8 <= edgeR; i += 8) {
+		uint64_t edges;
+		uint64_t obstacles;
+		memcpy(&edges, edgeRow + i, 8);
+		memcpy(&obstacles, obsRow + i, 8);
+		blocked |= edges | obstacles;
+	}
+	for (; i < edgeR; i++)
+		blocked |= edgeRow[i] | obsRow[i];
+
+	return (blocked == 0);
+}
+
+//Check that the edge pixel at x is a speck and not the course edge: the run
+//of edge pixels it's in is at most maxRun wide, and every pixel from the run
+//over to targetX (and targetX itself) is free of edges and obstacles.
+bool Navigate::stray_edge(const uchar *edgeRow, const uchar *obsRow, int x,
+		int targetX, int maxRun, int cols)
+{
+	//run of edge pixels around x, giving up once it's too wide
+	int runL = x;
+	int runR = x;
+	while (runL > 0 && edgeRow[runL - 1] != 0 && runR - runL < maxRun)
+		runL--;
+	while (runR < cols - 1 && edgeRow[runR + 1] != 0 && runR - runL < maxRun)
+		runR++;
+	if (runR - runL + 1 > maxRun)
+		return false;
+	if (targetX >= runL && targetX <= runR)
+		return false;
+
+	//nothing between the run and the target
+	int from = runR + 1;
+	int to = targetX;
+	if (targetX < runL) {
+		from = targetX;
+		to = runL - 1;
+	}
+	for (int i = from; i <= to; i++) {
+		if ((edgeRow[i] | obsRow[i]) != 0)
+			return false;
+	}
+	return true;
+}
+
+//Walk several routes from different starting columns and with different
+//leans on the workers and keep the one with the best score
+void Navigate::plan_multi(cv::Mat frameEdges, cv::Mat frameObstacles,
+		int64 deadline, NAV_ROUTE_T *best)
+{
+	const float starts[] = MULTI_START_OFFSETS;
+	const float biases[] = MULTI_BIASES;
+	int numStarts = sizeof(starts) / sizeof(starts[0]);
+	int numBiases = sizeof(biases) / sizeof(biases[0]);
+	int num = numStarts * numBiases;
+	int cols = frameEdges.cols;
+
+	//tables are shared by every walk, build them before any start
+	build_tables(frameEdges.cols, frameEdges.rows);
+
+	//first hypothesis (straight from the center) runs on this thread
+	std::vector<NAV_ROUTE_T> routes(num);
+	for (int h = 1; h < num; h++) {
+		int startX = cols / 2 + (int)(starts[h / numBiases] * cols);
+		int bias = (int)(biases[h % numBiases] * cols);
+		NAV_ROUTE_T *route = &routes[h];
+		p_pool.submit([this, frameEdges, frameObstacles, startX, bias, deadline, route]() {
+			walk_route(frameEdges, frameObstacles, 1, startX, bias, deadline, NULL, route, NULL);
+		});
+	}
+	walk_route(frameEdges, frameObstacles, 1, -1, 0, deadline, NULL, &routes[0], &p_debugImg);
+	p_pool.wait_idle();
+
+	//pick the best one (the center route wins ties)
+	int bestH = 0;
+	double bestScore = route_score(routes[0]);
+	for (int h = 1; h < num; h++) {
+		double score = route_score(routes[h]);
+		if (score > bestScore) {
+			bestScore = score;
+			bestH = h;
+		}
+	}
+	*best = routes[bestH];
+	planHypothesis = bestH;
+
+	//show the route we picked
+	for (int i = 0; i < (int)best->x.size(); i++)
+		p_debugImg.at<Vec3b>(Point(best->x.at(i), frameEdges.rows - 1 - i)) = Vec3b(0, 128, 255);
+}
+
+//Route from the cost map engine. It bails when the cheapest path runs into
+//an obstacle close to the truck.
+void Navigate::plan_dp(cv::Mat frameEdges, cv::Mat frameObstacles, NAV_ROUTE_T *route)
+{
+	//needs the whole frame classified
+	wait_rows(0);
+	build_tables(frameEdges.cols, frameEdges.rows);
+
+	p_costMap.build(frameEdges, frameObstacles, p_tables.minGap);
+	p_costMap.solve(&route->x, &route->objInRow);
+
+	route->complete = true;
+	route->clearance = 0;
+	route->bail = false;
+	route->bailToTheRight = false;
+	if (p_costMap.blockedByObstacle && p_costMap.blockedRow > p_tables.bailRow) {
+		route->bail = true;
+		route->bailToTheRight = p_costMap.obstacleOnRight;
+		if (verbose)
+			cout << "Cost map route blocked by obstacle at " << p_costMap.blockedRow << endl;
+	}
+	//an edge right under the bumper leaves no route at all, route_decision
+	//stops us until a frame gives us one
+	else if (route->x.empty() && verbose) {
+		cout << "Cost map route blocked at the bumper, stopping." << endl;
+	}
+
+	//show the route
+	for (int i = 0; i < (int)route->x.size(); i++)
+		p_debugImg.at<Vec3b>(Point(route->x.at(i), frameEdges.rows - 1 - i)) = Vec3b(0, 255, 255);
+}
+
+//Longer routes with more room on either side score higher, bailing is bad.
+//With the area counts built, obstacles in the wheel base corridor between
+//here and the bail row also count against it.
+double Navigate::route_score(const NAV_ROUTE_T &route)
+{
+	if (route.x.empty())
+		return -MULTI_BAIL_PENALTY;
+
+	double rows = (double)route.x.size();
+	double score = rows + MULTI_CLEARANCE_WEIGHT * ((double)route.clearance / rows);
+	if (route.bail)
+		score -= MULTI_BAIL_PENALTY;
+
+	if (p_integral.ready()) {
+		int yBot = p_tables.rows - 1;
+		int yTop = p_tables.bailRow;
+		int topI = std::min(yBot - yTop, (int)route.x.size() - 1);
+		int cx = (route.x[0] + route.x[topI]) / 2;
+		int wTop = p_tables.minGap[yTop];
+		int wBot = p_tables.minGap[yBot];
+		double area = (double)(yBot - yTop + 1) * (wTop + wBot) / 2;
+		if (area > 0) {
+			int obs = p_integral.obstacles_trapezoid(cx, yTop, wTop, yBot, wBot);
+			score -= MULTI_CORRIDOR_PENALTY * std::min(obs / area, 1.0);
+		}
+	}
+
+	return score;
+}
+
+//Turn a route into a speed and direction
+void Navigate::route_decision(const NAV_ROUTE_T &route, int midPoint,
+		int *nextSpeed, int *nextDirection)
+{
+	//no route at all (blocked at the bumper), stop and wait for a frame
+	//that has one
+	if (route.x.empty()) {
+		*nextSpeed = 0;
+		*nextDirection = 0;
+		return;
+	}
 
 	//look at route and determine current direction and speed
 	float dir = 0;
 	int divisor = 0;
-	int unchangedY = (int)route.size();
-	for (int i = 0; i < route.size(); i++) {
+	int unchangedY = (int)route.x.size();
+	for (int i = 0; i < route.x.size(); i++) {
 		//get direction we should go (weight according to where we are in image)
-		int xLoc = route.at(i);
-		int weight = (int)((EXP_MULTIPLIER / exp(EXP_FACTOR * i)) + 1);
-		if (objInRow.at(i))
-			weight *= OBJ_IN_ROW_MULTIPLIER;
+		int xLoc = route.x.at(i);
+		int weight = p_tables.weight[i];
+		if (route.objInRow.at(i))
+			weight *= params.objInRowMultiplier;
 		int distFromCenter = xLoc - midPoint;
 		dir += (weight*distFromCenter);
 		//keep track of our weight so we can divide accurately
 		divisor += weight;
 
 		//check if we should set the speed (non-middle point)
-		if (unchangedY == route.size() && i != 0 ) {
-			if (distFromCenter > SPEED_DIST_FROM_CENTER || 
-					distFromCenter < -SPEED_DIST_FROM_CENTER ) {
+		if (unchangedY == route.x.size() && i != 0 ) {
+			if (distFromCenter > params.speedDistFromCenter || 
+					distFromCenter < -params.speedDistFromCenter ) {
 				unchangedY = i;
 				//cout << "UnchangedY: " << i << endl;
 			}
 		}
 	}
 
-	//scale direction to weighted avg pixels per row
-	dir = dir / divisor;
+	//scale direction to weighted avg pixels per row (straight if nothing
+	//had any weight)
+	if (divisor != 0)
+		dir = dir / divisor;
+	else
+		dir = 0;
 	//since we find the mid-point the maximum 1 direciton can be is 
 	//1/4 the image, scale this to be between -100 and 100
-	int nextDirection = (int)(((float)dir * 100.0)/STEERING_SENSITIVITY);
-	if( nextDirection > 100 )
-		nextDirection = 100;
-	else if( nextDirection < -100 )
-		nextDirection = -100;
+	int direction = (int)(((float)dir * 100.0)/params.steeringSensitivity);
+	if( direction > 100 )
+		direction = 100;
+	else if( direction < -100 )
+		direction = -100;
 
 	//change speed
-	int nextSpeed;
-	if (unchangedY > SPEED_DIST0)
-		nextSpeed = SPEED_VAL0;
-	else if (unchangedY > SPEED_DIST1)
-		nextSpeed = SPEED_VAL1;
-	else if (unchangedY > SPEED_DIST2)
-		nextSpeed = SPEED_VAL2;
+	int speed;
+	if (unchangedY > params.speedDist0)
+		speed = params.speedVal0;
+	else if (unchangedY > params.speedDist1)
+		speed = params.speedVal1;
+	else if (unchangedY > params.speedDist2)
+		speed = params.speedVal2;
 	else {
-		nextSpeed = SPEED_VAL3;
+		speed = params.speedVal3;
 	}
-	nextSpeed = (int)((float)nextSpeed * SPEED_FACTOR);
+	speed = (int)((float)speed * params.speedFactor);
 
 	//increase speed if direction is sharp	
-	if( nextDirection > 50 )
-		nextSpeed = (nextSpeed * 4 ) / 3;
-	else if( nextDirection < -50 )
-		nextSpeed = (nextSpeed * 4 ) / 3;
-
+	if( direction > 50 )
+		speed = (speed * 4 ) / 3;
+	else if( direction < -50 )
+		speed = (speed * 4 ) / 3;
 
-	//set speed, direction, and bail values
-	speed = nextSpeed;
-	direction = nextDirection;
-	p_bail = nextBail;
-
-	//draw steering text on screen
-	std::string pSteering = "Direction: ";
-	pSteering.append( std::to_string( direction ) );
-	putText(p_debugImg, pSteering, Point(10, 10), FONT_HERSHEY_PLAIN, 1, CV_RGB(255, 0, 0), 1);
-
-	//draw drive text on screen
-	std::string pDrive= "Speed    : ";
-	pDrive.append( std::to_string( speed ) );
-	putText(p_debugImg, pDrive, Point(10, 30), FONT_HERSHEY_PLAIN, 1, CV_RGB(255, 0, 0), 1);
-
-	//show debug image
-	if( debugMode )
-		imshow("main", p_debugImg);
-	if( p_writeVideo && p_debugImg.size() == p_videoSize ) {
-		cout << "writing frame to video... " << p_debugImg.size() << endl;
-		p_video << p_debugImg;
-		cout << "frame complete... " << endl;
-	}
-	else if( p_writeVideo && p_debugImg.size() != p_videoSize)
-		cout << "Weird, frame came in differently..." << endl;
+	*nextSpeed = speed;
+	*nextDirection = direction;
 }
 	
 void Navigate::analyze_bail(cv::Mat frame)
@@ -428,30 +1117,40 @@ void Navigate::analyze_bail(cv::Mat frame)
 	case NAV_BAIL_STATE_BACKUP:
 	{
 		//back straight out until no objects are in bottom of image
-		speed = SPEED_VAL_BAK;
+		speed = params.speedValBak;
 		direction = 0;
 
 		//get obstacles
-		cv::Mat colors;
-		cvtColor(frame, colors, CV_RGB2HSV);
 		Mat frameObstacles;
-		get_obstacles(colors, &frameObstacles);
+		Mat frameEdges;
+		classify_pixels(frame, &frameObstacles, &frameEdges);
 		
 		//get lower portion of image
-		Rect R(Point(0, (int)((float)frame.rows*BAIL_PORTION_BEFORE_TURN)),
+		Rect R(Point(0, (int)((float)frame.rows*params.bailPortionBeforeTurn)),
 			Point(frame.cols - 1, frame.rows - 1));
 		Mat noBailPortion = frameObstacles(R);
 
-		//change state once no more object in this section of the image
+		if (blobMode)
+			p_tracker.update(frameObstacles);
+
+		//keep the map up to date while backing up
+		if (occupancyMode && groundMode) {
+			build_tables(frame.cols, frame.rows);
+			p_ground.warp(frameEdges, frameObstacles, &groundView);
+			p_occupancy.update(groundView, groundCamera);
+		}
+
+		//change state once no more object in this section of the image (or
+		//remembered in front of the bumper where the camera can't see)
 		int numObjPix = countNonZero(noBailPortion);
-		if ( numObjPix == 0) {
+		if ( numObjPix == 0 && blind_spot_clear(frame.cols, frame.rows)) {
 			p_bailState = NAV_BAIL_STATE_TURN;
 		}
 
 		//debug
 		Mat noBailColor;
 		cvtColor(noBailPortion, noBailColor, CV_GRAY2RGB);
-		frame.copyTo( p_debugImg );
+		debug_frame(frame);
 		Mat lowerPortion = p_debugImg(R);
 		noBailColor.copyTo(lowerPortion);
 		//draw steering text on screen
@@ -479,101 +1178,116 @@ void Navigate::analyze_bail(cv::Mat frame)
 	case NAV_BAIL_STATE_TURN:
 	{
 		//backup and set direction of tires to avoid obstacle
-		speed = SPEED_VAL_BAK;
+		speed = params.speedValBak;
 		if (p_bailToTheRight)
 			direction = -50;
 		else
 			direction = 50;
 
 		//get edges and obstacles
-		cv::Mat colors;
 		Mat frameObstacles;
 		Mat frameEdges;
-		cvtColor(frame, colors, CV_RGB2HSV);
-		get_obstacles(colors, &frameObstacles);
-		get_edges(colors, &frameEdges);
+		classify_pixels(frame, &frameObstacles, &frameEdges);
 
 		//create debug image
-		frame.copyTo(p_debugImg);
+		debug_frame(frame);
+
+		//nearest edge/object on each side of center is a lookup
+		p_clearance.clear();
+		if (clearanceMode)
+			p_clearance.build(frameEdges, frameObstacles);
 
 		//check if we've turned enough (first object edge is on opposite side)
 		int y;
 		int center = frameEdges.cols / 2;
-		int centerOffset = (int)((float)center * BAIL_CENTER_OFFSET);
+		int centerOffset = (int)((float)center * params.bailCenterOffset);
 		p_bail = true;
-		for (y = frameEdges.rows - 1; y >= 0; y--) {
-			//ensure we're not at an edge 
-			if (frameEdges.at<uchar>(Point(center, y)) == 0) {
-				//check that we're not at an obstacle
-				if (frameObstacles.at<uchar>(Point(center, y)) == 0) {
-					//find first edge point in both directions from center
-					int edgeL = center;
-					int edgeR = center;
-					while (edgeL > 0 &&
-							frameEdges.at<uchar>(Point(edgeL, y)) == 0 &&
-							frameObstacles.at<uchar>(Point(edgeL, y)) == 0) {
-						p_debugImg.at<Vec3b>(Point(edgeL, y)) = Vec3b(255, 0, 255);
-						edgeL--;
-					}
-					while (edgeR < (frameEdges.cols - 1) &&
-							frameEdges.at<uchar>(Point(edgeR, y)) == 0 &&
-							frameObstacles.at<uchar>(Point(edgeR, y)) == 0) {
-						p_debugImg.at<Vec3b>(Point(edgeR, y)) = Vec3b(255, 255, 0);
-						edgeR++;
-					}
-
-					//classify edge types and weight accordingly
-					EDGE_TYPE_T edgeLType = EDGE_TYPE_IMG;
-					EDGE_TYPE_T edgeRType = EDGE_TYPE_IMG;
-					if (frameObstacles.at<uchar>(Point(edgeL, y)) != 0)
-						edgeLType = EDGE_TYPE_OBJECT;
-					else if (frameEdges.at<uchar>(Point(edgeL, y)) != 0)
-						edgeLType = EDGE_TYPE_EDGE;
-					if (frameObstacles.at<uchar>(Point(edgeR, y)) != 0)
-						edgeRType = EDGE_TYPE_OBJECT;
-					else if (frameEdges.at<uchar>(Point(edgeR, y)) != 0)
-						edgeRType = EDGE_TYPE_EDGE;
-
-					//check if any edge is an object (only look at first object)
-					if (edgeLType == EDGE_TYPE_OBJECT || edgeRType == EDGE_TYPE_OBJECT) {
-						//check which direction we're trying to bail
-						if (p_bailToTheRight) {
-							//direction = -50;
-							//check if we turned enough
-							int distFromCenterL = center - edgeL;
-							if (edgeLType == EDGE_TYPE_OBJECT &&
-									distFromCenterL > centerOffset) {
-								//turned enough, don't bail
-								p_bail = false;
-							}
+		if (blobMode) {
+			//the nearest tracked cone tells us if we've turned enough
+			p_tracker.update(frameObstacles);
+			p_bail = !turned_past_blob(center, centerOffset);
+		}
+		else {
+			for (y = frameEdges.rows - 1; y >= 0; y--) {
+				//ensure we're not at an edge 
+				if (frameEdges.at<uchar>(Point(center, y)) == 0) {
+					//check that we're not at an obstacle
+					if (frameObstacles.at<uchar>(Point(center, y)) == 0) {
+						//find first edge point in both directions from center
+						int edgeL = center;
+						int edgeR = center;
+						if (p_clearance.ready()) {
+							edgeL = p_clearance.left(center, y);
+							edgeR = p_clearance.right(center, y);
 						}
 						else {
-							//direction = 50;
-							//check if we turned enough
-							int distFromCenterR = edgeR - center;
-							if (edgeRType == EDGE_TYPE_OBJECT &&
-									distFromCenterR > centerOffset) {
-								//turned enough, don't bail
-								p_bail = false;
+							while (edgeL > 0 &&
+									frameEdges.at<uchar>(Point(edgeL, y)) == 0 &&
+									frameObstacles.at<uchar>(Point(edgeL, y)) == 0) {
+								p_debugImg.at<Vec3b>(Point(edgeL, y)) = Vec3b(255, 0, 255);
+								edgeL--;
+							}
+							while (edgeR < (frameEdges.cols - 1) &&
+									frameEdges.at<uchar>(Point(edgeR, y)) == 0 &&
+									frameObstacles.at<uchar>(Point(edgeR, y)) == 0) {
+								p_debugImg.at<Vec3b>(Point(edgeR, y)) = Vec3b(255, 255, 0);
+								edgeR++;
 							}
 						}
 
-						//we found the first object, wait for next frame
+						//classify edge types and weight accordingly
+						EDGE_TYPE_T edgeLType = EDGE_TYPE_IMG;
+						EDGE_TYPE_T edgeRType = EDGE_TYPE_IMG;
+						if (frameObstacles.at<uchar>(Point(edgeL, y)) != 0)
+							edgeLType = EDGE_TYPE_OBJECT;
+						else if (frameEdges.at<uchar>(Point(edgeL, y)) != 0)
+							edgeLType = EDGE_TYPE_EDGE;
+						if (frameObstacles.at<uchar>(Point(edgeR, y)) != 0)
+							edgeRType = EDGE_TYPE_OBJECT;
+						else if (frameEdges.at<uchar>(Point(edgeR, y)) != 0)
+							edgeRType = EDGE_TYPE_EDGE;
+
+						//check if any edge is an object (only look at first object)
+						if (edgeLType == EDGE_TYPE_OBJECT || edgeRType == EDGE_TYPE_OBJECT) {
+							//check which direction we're trying to bail
+							if (p_bailToTheRight) {
+								//direction = -50;
+								//check if we turned enough
+								int distFromCenterL = center - edgeL;
+								if (edgeLType == EDGE_TYPE_OBJECT &&
+										distFromCenterL > centerOffset) {
+									//turned enough, don't bail
+									p_bail = false;
+								}
+							}
+							else {
+								//direction = 50;
+								//check if we turned enough
+								int distFromCenterR = edgeR - center;
+								if (edgeRType == EDGE_TYPE_OBJECT &&
+										distFromCenterR > centerOffset) {
+									//turned enough, don't bail
+									p_bail = false;
+								}
+							}
+
+							//we found the first object, wait for next frame
+							break;
+						}
+						//didn't find an object, look higher in image
+					}
+					//straight into an obstacle
+					else {
+						//keep backing up (wait for next frame)
 						break;
 					}
-					//didn't find an object, look higher in image
 				}
-				//straight into an obstacle
+				//we hit an edge immediately.  What the?
 				else {
-					//keep backing up (wait for next frame)
-					break;
+					//crap, are we going the wrong way? No, we really don't even care about edges here..
+					//waitKey();
 				}
 			}
-			//we hit an edge immediately.  What the?
-			else {
-				//crap, are we going the wrong way? No, we really don't even care about edges here..
-				//waitKey();
-			}
 		}
 
 		//draw steering text on screen
@@ -604,43 +1318,342 @@ void Navigate::analyze_bail(cv::Mat frame)
 //				1/6 width of frame at top of frame (1/5)
 // 3/4 image width at bottom
 // 1/5 image width at top
-// image 160x90
-int Navigate::get_min_dist(int y)
+// tuned on 160x90 images (where cols / 8 is 20)
+int Navigate::get_min_dist(int y, int cols, int rows)
 {
-	int topW = (160 / 6);
-	int botW = ((160 * 3) / 4) - 20;
+	int topW = (cols / 6);
+	int botW = ((cols * 3) / 4) - (cols / 8);
 	int diff = botW - topW;
 
-	int dist = ((( y * diff ) / 90) + topW);
+	int dist = ((( y * diff ) / rows) + topW);
 
 	return (dist);
 }
+
+//Build the per row tables for this frame size, only when the size or
+//parameters changed since last time. In ground mode the truck width comes
+//from the camera calibration instead of the straight line model.
+void Navigate::build_tables(int cols, int rows)
+{
+	if (p_tables.cols == cols && p_tables.rows == rows &&
+			memcmp(&p_tableParams, &params, sizeof(params)) == 0 &&
+			p_tableGround == groundMode &&
+			(!groundMode || p_ground.built_for(cols, rows, groundCamera)))
+		return;
+
+	if (groundMode)
+		p_ground.build(cols, rows, groundCamera);
+
+	p_tables.cols = cols;
+	p_tables.rows = rows;
+	p_tables.weight.resize(rows);
+	p_tables.minGap.resize(rows);
+	for (int i = 0; i < rows; i++) {
+		//route weight by rows from the bottom (falls off going up)
+		p_tables.weight[i] = (int)((params.expMultiplier / exp(params.expFactor * i)) + 1);
+		//truck width by image row
+		p_tables.minGap[i] = get_min_dist(i, cols, rows);
+		if (groundMode) {
+			//rows above the horizon keep the straight line model
+			int width = (int)p_ground.width_px(i, TRUCK_WIDTH);
+			if (width > 0)
+				p_tables.minGap[i] = width;
+		}
+	}
+	p_tables.bailRow = (int)((float)rows * params.bailDistanceFactor);
+	p_tables.halfRow = rows / 2;
+	p_tableParams = params;
+	p_tableGround = groundMode;
+}
+//Get obstacle and edge masks for a frame. In pyramid mode only the far rows
+//(where cones are small) are classified at full resolution, near rows are
+//classified at half resolution. Those are kept for the walk and scaled back
+//up into the full size masks.
+void Navigate::classify(cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges)
+{
+	if (p_pool.workers() > 0 && (!pyramidMode || frame.cols < PYRAMID_MIN_COLS ||
+				frame.type() == CV_8UC2)) {
+		//split into bands and classify them on the workers, the walk picks
+		//up bottom bands as they finish (see classify_wait)
+		classify_bands(frame, frameObstacles, frameEdges);
+		p_nearEdges.release();
+		p_nearObstacles.release();
+		p_nearRow = frame.rows;
+		p_nearStep = 1;
+		return;
+	}
+
+	//(pyrDown would mix U and V of a YUYV frame, the table is cheap enough
+	//to classify all of it anyway)
+	if (!pyramidMode || frame.cols < PYRAMID_MIN_COLS || frame.type() == CV_8UC2) {
+		classify_pixels(frame, frameObstacles, frameEdges);
+		p_nearEdges.release();
+		p_nearObstacles.release();
+		p_nearRow = frame.rows;
+	}
+	else {
+		int split = (int)((float)frame.rows * PYRAMID_FAR_PORTION);
+		frameObstacles->create(frame.size(), CV_8UC1);
+		frameEdges->create(frame.size(), CV_8UC1);
+
+		//far rows at full resolution
+		Mat farObstacles = frameObstacles->rowRange(0, split);
+		Mat farEdges = frameEdges->rowRange(0, split);
+		classify_pixels(frame.rowRange(0, split), &farObstacles, &farEdges);
+
+		//near rows at half resolution
+		Mat nearSmall;
+		Mat obstaclesSmall;
+		Mat edgesSmall;
+		pyrDown(frame.rowRange(split, frame.rows), nearSmall);
+		classify_pixels(nearSmall, &obstaclesSmall, &edgesSmall);
+
+		//the walk reads these directly, the full size masks get a scaled up
+		//copy for everything else
+		p_nearObstacles = obstaclesSmall;
+		p_nearEdges = edgesSmall;
+		Mat nearObstacles = frameObstacles->rowRange(split, frame.rows);
+		Mat nearEdges = frameEdges->rowRange(split, frame.rows);
+		resize(obstaclesSmall, nearObstacles, nearObstacles.size(), 0, 0, INTER_NEAREST);
+		resize(edgesSmall, nearEdges, nearEdges.size(), 0, 0, INTER_NEAREST);
+		p_nearRow = split;
+	}
+	p_nearStep = PYRAMID_NEAR_STEP;
+	p_showObstacles = *frameObstacles;
+	p_showEdges = *frameEdges;
+	set_ready_row(0);
+}
+
+//Queue horizontal bands of the frame on the workers, bottom band first
+void Navigate::classify_bands(cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges)
+{
+	frameObstacles->create(frame.size(), CV_8UC1);
+	frameEdges->create(frame.size(), CV_8UC1);
+
+	int bands = p_pool.workers() * BANDS_PER_WORKER;
+	if (bands > frame.rows / BAND_MIN_ROWS)
+		bands = frame.rows / BAND_MIN_ROWS;
+	if (bands < 1)
+		bands = 1;
+
+	{
+		std::lock_guard<std::mutex> guard(p_bandLock);
+		p_bandTop.resize(bands);
+		p_bandDone.assign(bands, 0);
+		p_bandsReady = 0;
+		p_readyRow = frame.rows;
+	}
+	p_showObstacles = *frameObstacles;
+	p_showEdges = *frameEdges;
+
+	int bottom = frame.rows;
+	for (int b = 0; b < bands; b++) {
+		int top = frame.rows - ((b + 1) * frame.rows) / bands;
+		p_bandTop[b] = top;
+		Mat bandFrame = frame.rowRange(top, bottom);
+		Mat bandObstacles = frameObstacles->rowRange(top, bottom);
+		Mat bandEdges = frameEdges->rowRange(top, bottom);
+		p_pool.submit([this, b, bandFrame, bandObstacles, bandEdges]() {
+			Mat obstacles = bandObstacles;
+			Mat edges = bandEdges;
+			classify_pixels(bandFrame, &obstacles, &edges);
+			band_done(b);
+		});
+		bottom = top;
+	}
+}
+
+//Mark a band finished and move the ready row up past every finished band
+//that is connected to the bottom of the frame
+void Navigate::band_done(int band)
+{
+	std::lock_guard<std::mutex> guard(p_bandLock);
+	p_bandDone[band] = 1;
+	while (p_bandsReady < (int)p_bandDone.size() && p_bandDone[p_bandsReady]) {
+		p_readyRow = p_bandTop[p_bandsReady];
+		p_bandsReady++;
+	}
+	p_bandReady.notify_all();
+}
+
+//Rows from the returned row down are classified
+int Navigate::ready_row(void)
+{
+	std::lock_guard<std::mutex> guard(p_bandLock);
+	return p_readyRow;
+}
+
+void Navigate::set_ready_row(int row)
+{
+	std::lock_guard<std::mutex> guard(p_bandLock);
+	p_readyRow = row;
+}
+
+//Wait until row y is classified
+int Navigate::wait_rows(int y)
+{
+	return wait_rows_until(y, 0);
+}
+
+//Wait until row y is classified or the deadline tick passes (0 for no
+//deadline). Returns the top classified row, still below y if out of time.
+int Navigate::wait_rows_until(int y, int64 deadline)
+{
+	std::unique_lock<std::mutex> guard(p_bandLock);
+	while (p_readyRow > y) {
+		if (deadline <= 0) {
+			p_bandReady.wait(guard);
+			continue;
+		}
+		int64 left = deadline - getTickCount();
+		if (left <= 0)
+			break;
+		p_bandReady.wait_for(guard, std::chrono::microseconds(
+				(long long)(((double)left * 1000000.0) / getTickFrequency()) + 1));
+	}
+	return p_readyRow;
+}
+
+//Wait for the whole frame to be classified
+void Navigate::classify_wait(void)
+{
+	wait_rows(0);
+
+	if( showObjects )
+		imshow( "obstacles", p_showObstacles );
+	if( showEdges )
+		imshow( "edges", p_showEdges );
+}
+
+//Classify on this many worker threads (0 classifies on the calling thread).
+//Worker i is pinned to firstCore + i unless firstCore is SCHED_CORE_ANY.
+void Navigate::set_workers(int workers, int firstCore)
+{
+	if (workers > 0)
+		p_pool.start(workers, firstCore);
+	else
+		p_pool.stop();
+}
+
+//Obstacle and edge masks for some pixels, from the trained tree or the HSV
+//boxes in params
+void Navigate::classify_pixels(cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges)
+{
+	//YUYV straight from the camera, only the colour table reads it as is
+	if (frame.type() == CV_8UC2) {
+		std::shared_ptr<const ColorTable> table;
+		if (lutMode && !treeMode)
+			table = std::atomic_load(&p_lut);
+		if (table) {
+			table->classify_yuyv(frame, frameObstacles, frameEdges);
+			return;
+		}
+		Mat decoded;
+		cvtColor(frame, decoded, COLOR_YUV2BGR_YUYV);
+		frame = decoded;
+	}
+
+	if (treeMode) {
+		tree_classify(frame, frameObstacles, frameEdges);
+		return;
+	}
+
+	//colour table, falls through to HSV until the first one is built
+	if (lutMode) {
+		std::shared_ptr<const ColorTable> table = std::atomic_load(&p_lut);
+		if (table) {
+			table->classify(frame, frameObstacles, frameEdges);
+			return;
+		}
+	}
+
+	//convert frame to HSV Color Space
+	cv::Mat colors;
+	cvtColor(frame, colors, CV_RGB2HSV);
+	get_obstacles(colors, frameObstacles);
+	get_edges(colors, frameEdges);
+}
+
+//Frame the debug drawing goes on (never the camera's buffer, others may be
+//reading it). Only copied or decoded when someone is watching or recording,
+//otherwise we draw on whatever was left in the buffer.
+void Navigate::debug_frame(cv::Mat frame)
+{
+	if (!debugMode && !p_writeVideo)
+		p_debugImg.create(frame.size(), CV_8UC3);
+	else if (frame.type() == CV_8UC2)
+		cvtColor(frame, p_debugImg, COLOR_YUV2BGR_YUYV);
+	else
+		frame.copyTo(p_debugImg);
+}
+
 void Navigate::get_obstacles(cv::Mat hsvImg, cv::Mat *frameObstacles)
 {
 	//get obstacles in image (orange)
-	int satMin = 175;
-	int hueCenter = 116; //lower is more orange
-	int hueMin = hueCenter - 8;
-	int hueMax = hueCenter + 8;
-	int valMin = 60;
-	int valMax = 255;
+	int satMin = params.obstacleSatMin;
+	int hueCenter = params.obstacleHueCenter; //lower is more orange
+	int hueMin = hueCenter - params.obstacleHueRange;
+	int hueMax = hueCenter + params.obstacleHueRange;
+	int valMin = params.obstacleValMin;
+	int valMax = params.obstacleValMax;
 	inRange(hsvImg, Scalar(hueMin, satMin, valMin), Scalar(hueMax, 255, valMax), *frameObstacles);
-	if( showObjects )
-		imshow( "obstacles", *frameObstacles );
 }
 
 void Navigate::get_edges(cv::Mat hsvImg, cv::Mat *frameEdges)
 {
 	//get course edges (blue)
-	int satMin = 100;
-	int hueCenter = 18;
-	int hueMin = hueCenter - 14;
-	int hueMax = hueCenter + 14;
-	int valMin = 50;
-	int valMax = 255;
+	int satMin = params.edgeSatMin;
+	int hueCenter = params.edgeHueCenter;
+	int hueMin = hueCenter - params.edgeHueRange;
+	int hueMax = hueCenter + params.edgeHueRange;
+	int valMin = params.edgeValMin;
+	int valMax = params.edgeValMax;
 	inRange(hsvImg, Scalar(hueMin, satMin, valMin), Scalar(hueMax, 255, valMax), *frameEdges);
-	if( showEdges )
-		imshow( "edges", *frameEdges );
+}
+
+//Build a colour table from the current params on a background thread, the
+//frames keep using the old table (or HSV) until the new one is swapped in.
+//Calling again while a build is running queues one more build.
+void Navigate::rebuild_classifier(void)
+{
+	std::lock_guard<std::mutex> guard(p_lutLock);
+	p_lutParams = params;
+	p_lutDirty = true;
+	if (p_lutBuilding)
+		return;
+
+	p_lutBuilding = true;
+	if (p_lutThread.joinable())
+		p_lutThread.join();
+	p_lutThread = std::thread(&Navigate::build_classifier, this);
+}
+
+void Navigate::build_classifier(void)
+{
+	while (true) {
+		NAV_PARAMS_T p;
+		{
+			std::lock_guard<std::mutex> guard(p_lutLock);
+			if (!p_lutDirty) {
+				p_lutBuilding = false;
+				return;
+			}
+			p = p_lutParams;
+			p_lutDirty = false;
+		}
+
+		COLOR_BOX_T obstacle = { p.obstacleHueCenter - p.obstacleHueRange,
+			p.obstacleHueCenter + p.obstacleHueRange,
+			p.obstacleSatMin, p.obstacleValMin, p.obstacleValMax };
+		COLOR_BOX_T edge = { p.edgeHueCenter - p.edgeHueRange,
+			p.edgeHueCenter + p.edgeHueRange,
+			p.edgeSatMin, p.edgeValMin, p.edgeValMax };
+
+		std::shared_ptr<ColorTable> table = std::make_shared<ColorTable>();
+		table->build(obstacle, edge);
+		std::atomic_store(&p_lut, std::shared_ptr<const ColorTable>(table));
+		lutBuilds++;
+	}
 }
 
 void Navigate::start_video( cv::Size videoSize )
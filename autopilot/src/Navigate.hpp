@@ -7,9 +7,29 @@
 
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+#include "NavProfile.hpp"
+#include "ThreadPool.hpp"
+#include "CostMap.hpp"
+#include "ClearanceMap.hpp"
+#include "MaskIntegral.hpp"
+#include "GroundMap.hpp"
+#include "OccupancyGrid.hpp"
+#include "BlobTracker.hpp"
+#include "EdgeModel.hpp"
+#include "ColorTable.hpp"
 
 /*************************** Definitions *************************************/
 
+/** Walk deadline: walk only rows already classified, never wait on a band */
+#define NAV_DEADLINE_READY -1
+
 /** Navigate state machine */
 typedef enum NAV_STATE_E {
     NAV_STATE_FORWARD = 0,
@@ -24,6 +44,67 @@ typedef enum NAV_BAIL_STATE_E {
 	NAV_BAIL_STATE_NUMS
 } NAV_BAIL_STATE_T;
 
+/** Route engines */
+typedef enum NAV_ENGINE_E {
+	NAV_ENGINE_GREEDY = 0,  //single walk up from the center
+	NAV_ENGINE_MULTI,       //several walks in parallel, best one wins
+	NAV_ENGINE_DP,          //cheapest path through a cost map (CostMap)
+	NAV_ENGINE_NUMS
+} NAV_ENGINE_T;
+
+/** Planner tuning, can be changed between frames */
+typedef struct NAV_PARAMS_S {
+	//steering
+	float expFactor;            //how fast row weight falls off going up
+	float expMultiplier;
+	float steeringSensitivity;  //higher is less sensitive
+	int objInRowMultiplier;     //extra weight for rows next to an object
+
+	//speed
+	int speedDistFromCenter;    //route this far off center limits speed
+	int speedDist0;
+	int speedDist1;
+	int speedDist2;
+	int speedVal0;
+	int speedVal1;
+	int speedVal2;
+	int speedVal3;
+	int speedValBak;
+	float speedFactor;          //battery level: high=0.6, med=0.8, low=1.0
+
+	//bailing
+	float bailDistanceFactor;   //only bail for gaps below this portion
+	float bailPortionBeforeTurn;
+	float bailCenterOffset;
+	int bailFrames;             //frames in a row before changing state
+
+	//obstacles (orange, HSV)
+	int obstacleHueCenter;
+	int obstacleHueRange;
+	int obstacleSatMin;
+	int obstacleValMin;
+	int obstacleValMax;
+
+	//course edges (blue, HSV)
+	int edgeHueCenter;
+	int edgeHueRange;
+	int edgeSatMin;
+	int edgeValMin;
+	int edgeValMax;
+} NAV_PARAMS_T;
+
+/** Route found by walking up the image */
+typedef struct NAV_ROUTE_S {
+	std::vector<int> x;          //target x of each row, starting at the bottom
+	std::vector<bool> objInRow;  //an object bounds the gap in this row
+	bool bail;                   //we can't fit and should back up
+	bool bailToTheRight;
+	bool complete;               //false if we ran out of time
+	int clearance;               //room beyond the truck width, summed over rows
+	std::vector<int> gapL;       //left end of the gap at each y (-1 not scanned)
+	std::vector<int> gapR;       //right end of the gap at each y
+} NAV_ROUTE_T;
+
 class Navigate {
 	//variables
 public:
@@ -33,13 +114,47 @@ public:
 	bool showObjects;
 	bool showEdges;
 	bool writeVideoVerbose;
+	bool verbose;         //print what the planner is doing
+	NAV_PARAMS_T params;
+	int planBudgetUs;     //time allowed for planning a frame (0 = unlimited)
+	int planRowsRefined;  //rows of the last route planned at full detail
+	int planRowsTotal;    //rows in the last route
+	bool planComplete;    //last route was fully refined in time
+	bool pyramidMode;     //classify/plan near rows at half resolution
+	NAV_ENGINE_T routeEngine;
+	int planHypothesis;   //route picked by the multi engine (0 = center)
+	bool temporalMode;    //start each frame from the last frame's gaps
+	long cacheRowsHit;    //rows where last frame's gap still held
+	long cacheRowsScanned;//rows that had to be scanned again
+	bool skipMode;        //reuse the last decision while the scene isn't changing
+	long framesAnalyzed;
+	long framesSkipped;   //frames that reused the last decision
+	bool clearanceMode;   //look gaps up in a clearance map instead of scanning
+	                      //(waits for the whole frame, overrides temporalMode)
+	bool integralMode;    //count corridor obstacles for the multi engine
+	bool groundMode;      //truck width from the camera calibration, bird's eye view
+	GROUND_CAMERA_T groundCamera;
+	cv::Mat groundView;   //last frame's labels on the ground (GROUND_*)
+	bool occupancyMode;   //remember the ground view across frames (needs groundMode)
+	bool blobMode;        //track cones as blobs for the bail decisions
+	bool edgeModelMode;   //fit curves to the course edges, walk past stray edge
+	                      //pixels (fit after the walk, it uses last frame's)
+	bool treeMode;        //classify pixels with the trained tree (TreeClassifier.hpp)
+	bool lutMode;         //classify pixels with a colour table built from params
+	std::atomic<long> lutBuilds;  //colour tables built so far
 
 	//methods
 public:
 	Navigate();
-	void analyze_frame(cv::Mat frame);
+	Navigate(const NAV_PARAMS_T &navParams);
+	~Navigate();
+	static NAV_PARAMS_T default_params(void);
+	void analyze_frame(cv::Mat frame);   //BGR (CV_8UC3) or YUYV (CV_8UC2)
+	bool is_bailing(void);
+	void set_workers(int workers, int firstCore);
 	void start_video( cv::Size videoSize );
 	void end_video(void );
+	void rebuild_classifier(void);
 	//void analyze_bail(cv::Mat frame);
 
 	//private variables
@@ -53,13 +168,81 @@ private:
 	bool p_writeVideo;
 	cv::VideoWriter p_video;
 	cv::Size p_videoSize;
+	NAV_TABLES_T p_tables;
+	NAV_PARAMS_T p_tableParams;  //params the tables were built with
+	int p_nearRow;   //rows from here down were classified at low resolution
+	int p_nearStep;  //row step for walking those rows
+	cv::Mat p_nearEdges;      //those rows at half resolution (empty when
+	cv::Mat p_nearObstacles;  //everything was classified at full size)
+	ThreadPool p_pool;
+	CostMap p_costMap;
+	ClearanceMap p_clearance;
+	MaskIntegral p_integral;
+	GroundMap p_ground;
+	bool p_tableGround;   //tables were built in ground mode
+	OccupancyGrid p_occupancy;
+	int64 p_lastFrameTick;  //when the last frame came in (moving the map)
+	BlobTracker p_tracker;
+	EdgeModel p_edgeModel;
+	int p_bailBlob;         //ID of the tracked cone close in front of the truck
+	                        //(-1 for none), kept through a bail
+	NAV_ROUTE_T p_prevRoute;  //last frame's route (temporal mode)
+	std::mutex p_bandLock;
+	std::condition_variable p_bandReady;
+	std::vector<int> p_bandTop;    //top row of each band, bottom band first
+	std::vector<char> p_bandDone;
+	int p_bandsReady;              //bands finished from the bottom up
+	int p_readyRow;                //rows from here down are classified
+	cv::Mat p_sceneSig;   //signature of the last analyzed frame
+	int p_skipStreak;     //frames skipped since the last analyzed one
+	std::shared_ptr<const ColorTable> p_lut;  //swapped in whole by the builder
+	std::mutex p_lutLock;
+	NAV_PARAMS_T p_lutParams;  //params the next table is built from
+	bool p_lutDirty;           //params changed since the builder took them
+	bool p_lutBuilding;        //builder thread is running
+	std::thread p_lutThread;
+	cv::Mat p_showObstacles;
+	cv::Mat p_showEdges;
 
 
 	//private methods
 private:
+	void init(const NAV_PARAMS_T &navParams);
 	void analyze_forward( cv::Mat frame );
 	void analyze_bail( cv::Mat frame );
-	int get_min_dist(int y);
+	bool scene_unchanged(cv::Mat frame);
+	bool blind_spot_clear(int cols, int rows);
+	bool turned_past_blob(int center, int centerOffset);
+	void walk_route(cv::Mat frameEdges, cv::Mat frameObstacles, int step,
+			int startX, int bias, int64 deadline, const NAV_ROUTE_T *prev,
+			NAV_ROUTE_T *route, cv::Mat *debugImg);
+	bool gap_holds(int edgeL, int edgeR, int x, int cols,
+			const uchar *edgeRow, const uchar *obsRow);
+	bool stray_edge(const uchar *edgeRow, const uchar *obsRow, int x,
+			int targetX, int maxRun, int cols);
+	void plan_multi(cv::Mat frameEdges, cv::Mat frameObstacles,
+			int64 deadline, NAV_ROUTE_T *best);
+	double route_score(const NAV_ROUTE_T &route);
+	void plan_dp(cv::Mat frameEdges, cv::Mat frameObstacles, NAV_ROUTE_T *route);
+	void route_decision(const NAV_ROUTE_T &route, int midPoint,
+			int *nextSpeed, int *nextDirection);
+	template<class P>
+	void walk_route_kernel(cv::Mat frameEdges, cv::Mat frameObstacles,
+			int step, int startX, int bias, int64 deadline, const NAV_ROUTE_T *prev,
+			NAV_ROUTE_T *route, cv::Mat *debugImg);
+	void build_tables(int cols, int rows);
+	int get_min_dist(int y, int cols, int rows);
+	void classify(cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges);
+	void classify_bands(cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges);
+	void classify_wait(void);
+	void band_done(int band);
+	int ready_row(void);
+	void set_ready_row(int row);
+	int wait_rows(int y);
+	int wait_rows_until(int y, int64 deadline);
+	void build_classifier(void);
+	void classify_pixels(cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges);
+	void debug_frame(cv::Mat frame);
 	void get_obstacles(cv::Mat hsvImg, cv::Mat *frameObstacles);
 	void get_edges(cv::Mat hsvImg, cv::Mat *frameEdges);
 };
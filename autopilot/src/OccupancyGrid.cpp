@@ -0,0 +1,216 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "OccupancyGrid.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+/****************************** Definitions **********************************/
+
+//cells on a side (power of two, the ring index is a mask)
+#define OCC_CELLS 128
+#define OCC_MASK (OCC_CELLS - 1)
+//cell edge length in meters (128 cells covers 5 m around the truck)
+#define OCC_CELL_SIZE 0.04
+
+//evidence added for seeing something in a cell, taken away for seeing it empty
+#define OCC_HIT 64
+#define OCC_MISS 16
+//evidence needed before a cell counts as occupied
+#define OCC_THRESHOLD 96
+
+//what a frame saw in a cell (any ground cell in it counts)
+#define OCC_SAW_GROUND 1
+#define OCC_SAW_OBSTACLE 2
+#define OCC_SAW_EDGE 4
+
+//commanded motion model (no encoders on the truck yet)
+//meters per second for each unit of drive speed
+#define OCC_SPEED_SCALE 0.05
+//front wheel angle in radians for each unit of steering
+#define OCC_STEER_SCALE 0.005
+//meters between the axles
+#define OCC_WHEELBASE 0.26
+
+using std::min;
+using std::max;
+
+/****************************** Implementation *******************************/
+
+OccupancyGrid::OccupancyGrid( void )
+{
+	reset();
+}
+
+void OccupancyGrid::reset( void )
+{
+	p_posX = 0;
+	p_posY = 0;
+	p_heading = 0;
+	p_originX = 0;
+	p_originY = 0;
+	p_obstacle.assign( OCC_CELLS * OCC_CELLS, 0 );
+	p_edge.assign( OCC_CELLS * OCC_CELLS, 0 );
+	p_seen.assign( OCC_CELLS * OCC_CELLS, 0 );
+	p_touched.clear();
+	p_touched.reserve( OCC_CELLS * OCC_CELLS );
+}
+
+//Move the truck distance meters forward (negative backs up) while turning
+//turn radians. Encoder readings can come straight in here.
+void OccupancyGrid::move( float distance, float turn )
+{
+	//go straight along the average heading
+	double heading = p_heading + turn / 2.0;
+	p_posX += distance * sin( heading );
+	p_posY += distance * cos( heading );
+	p_heading += turn;
+
+	//clear the cells that just came into range
+	int originX = cell_of( p_posX );
+	int originY = cell_of( p_posY );
+	if( abs( originX - p_originX ) >= OCC_CELLS || abs( originY - p_originY ) >= OCC_CELLS ) {
+		std::fill( p_obstacle.begin(), p_obstacle.end(), 0 );
+		std::fill( p_edge.begin(), p_edge.end(), 0 );
+	}
+	else {
+		for( int x = p_originX; x < originX; x++ )
+			clear_column( x + OCC_CELLS / 2 );
+		for( int x = p_originX; x > originX; x-- )
+			clear_column( x - 1 - OCC_CELLS / 2 );
+		for( int y = p_originY; y < originY; y++ )
+			clear_row( y + OCC_CELLS / 2 );
+		for( int y = p_originY; y > originY; y-- )
+			clear_row( y - 1 - OCC_CELLS / 2 );
+	}
+	p_originX = originX;
+	p_originY = originY;
+}
+
+//Move by what we told the truck to do for dt seconds (bicycle model)
+void OccupancyGrid::move_commanded( int speed, int direction, double dt )
+{
+	float distance = (float)( speed * OCC_SPEED_SCALE * dt );
+	float turn = distance * tanf( direction * OCC_STEER_SCALE ) / OCC_WHEELBASE;
+	move( distance, turn );
+}
+
+//Add what the camera sees now. Cells of the ground view are x right and y
+//ahead of the lens (far row first), see GroundMap. Ground cells are smaller
+//than ours, so first gather what each of our cells saw (an obstacle or edge
+//if any ground cell in it was one), then add one hit or miss per cell.
+void OccupancyGrid::update( cv::Mat ground, const GROUND_CAMERA_T &camera )
+{
+	for( int gy = 0; gy < ground.rows; gy++ ) {
+		const uchar *row = ground.ptr<uchar>( gy );
+		float ahead = camera.farDist - ( gy + 0.5f ) * camera.cellSize;
+		for( int gx = 0; gx < ground.cols; gx++ ) {
+			if( row[gx] == GROUND_UNSEEN )
+				continue;
+			float side = ( gx + 0.5f ) * camera.cellSize - camera.halfWidth;
+			double x, y;
+			to_world( side, ahead, &x, &y );
+			int i = index( cell_of( x ), cell_of( y ) );
+
+			if( p_seen[i] == 0 )
+				p_touched.push_back( i );
+			p_seen[i] |= OCC_SAW_GROUND;
+			if( row[gx] == GROUND_OBSTACLE )
+				p_seen[i] |= OCC_SAW_OBSTACLE;
+			else if( row[gx] == GROUND_EDGE )
+				p_seen[i] |= OCC_SAW_EDGE;
+		}
+	}
+
+	//more evidence for what we see, less for what we don't
+	for( int t = 0; t < (int)p_touched.size(); t++ ) {
+		int i = p_touched[t];
+		if( p_seen[i] & OCC_SAW_OBSTACLE )
+			p_obstacle[i] = (unsigned char)min( p_obstacle[i] + OCC_HIT, 255 );
+		else
+			p_obstacle[i] = (unsigned char)max( p_obstacle[i] - OCC_MISS, 0 );
+		if( p_seen[i] & OCC_SAW_EDGE )
+			p_edge[i] = (unsigned char)min( p_edge[i] + OCC_HIT, 255 );
+		else
+			p_edge[i] = (unsigned char)max( p_edge[i] - OCC_MISS, 0 );
+		p_seen[i] = 0;
+	}
+	p_touched.clear();
+}
+
+//Occupied cells in a box around the truck, in meters right of and ahead of
+//the lens
+int OccupancyGrid::obstacles_in( float sideMin, float sideMax, float aheadMin, float aheadMax )
+{
+	return count_in( p_obstacle, sideMin, sideMax, aheadMin, aheadMax );
+}
+
+int OccupancyGrid::edges_in( float sideMin, float sideMax, float aheadMin, float aheadMax )
+{
+	return count_in( p_edge, sideMin, sideMax, aheadMin, aheadMax );
+}
+
+int OccupancyGrid::cell_of( double meters )
+{
+	return (int)floor( meters / OCC_CELL_SIZE );
+}
+
+//World cells wrap around the ring, only cells near the truck are kept
+int OccupancyGrid::index( int cellX, int cellY )
+{
+	return ( cellY & OCC_MASK ) * OCC_CELLS + ( cellX & OCC_MASK );
+}
+
+void OccupancyGrid::clear_column( int cellX )
+{
+	int x = cellX & OCC_MASK;
+	for( int y = 0; y < OCC_CELLS; y++ ) {
+		p_obstacle[y * OCC_CELLS + x] = 0;
+		p_edge[y * OCC_CELLS + x] = 0;
+	}
+}
+
+void OccupancyGrid::clear_row( int cellY )
+{
+	int y = cellY & OCC_MASK;
+	std::fill( p_obstacle.begin() + y * OCC_CELLS, p_obstacle.begin() + ( y + 1 ) * OCC_CELLS, 0 );
+	std::fill( p_edge.begin() + y * OCC_CELLS, p_edge.begin() + ( y + 1 ) * OCC_CELLS, 0 );
+}
+
+//Truck relative (right, ahead) to world meters
+void OccupancyGrid::to_world( float side, float ahead, double *x, double *y )
+{
+	double s = sin( p_heading );
+	double c = cos( p_heading );
+	*x = p_posX + side * c + ahead * s;
+	*y = p_posY - side * s + ahead * c;
+}
+
+int OccupancyGrid::count_in( const std::vector<unsigned char> &evidence, float sideMin,
+		float sideMax, float aheadMin, float aheadMax )
+{
+	//anything past half the ring isn't kept
+	float range = ( OCC_CELLS / 2 - 1 ) * OCC_CELL_SIZE;
+	sideMin = max( sideMin, -range );
+	sideMax = min( sideMax, range );
+	aheadMin = max( aheadMin, -range );
+	aheadMax = min( aheadMax, range );
+
+	int count = 0;
+	for( float ahead = aheadMin; ahead <= aheadMax; ahead += OCC_CELL_SIZE ) {
+		for( float side = sideMin; side <= sideMax; side += OCC_CELL_SIZE ) {
+			double x, y;
+			to_world( side, ahead, &x, &y );
+			if( evidence[index( cell_of( x ), cell_of( y ) )] >= OCC_THRESHOLD )
+				count++;
+		}
+	}
+	return count;
+}
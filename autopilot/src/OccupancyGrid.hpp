@@ -0,0 +1,55 @@
+/******************************************************************************
+ * OccupancyGrid Class - Map of the ground around the truck that remembers
+ *                       obstacles and edges after they leave the camera's
+ *                       view. Cells live in a fixed size ring buffer indexed
+ *                       by world cell, so moving the truck only clears the
+ *                       cells that come into range. Each frame's bird's eye
+ *                       view (GroundMap) adds to or fades what is there,
+ *                       once per grid cell (several ground cells fall in
+ *                       each grid cell).
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+#include "GroundMap.hpp"
+
+class OccupancyGrid {
+	//methods
+public:
+	OccupancyGrid();
+	void reset(void);
+	void move(float distance, float turn);
+	void move_commanded(int speed, int direction, double dt);
+	void update(cv::Mat ground, const GROUND_CAMERA_T &camera);
+	int obstacles_in(float sideMin, float sideMax, float aheadMin, float aheadMax);
+	int edges_in(float sideMin, float sideMax, float aheadMin, float aheadMax);
+
+	//private variables
+private:
+	double p_posX;      //truck position in meters (x right of where we started)
+	double p_posY;      //(y ahead of where we started)
+	double p_heading;   //radians, positive is turned right
+	int p_originX;      //world cell the truck is in
+	int p_originY;
+	std::vector<unsigned char> p_obstacle;  //evidence each cell is an obstacle
+	std::vector<unsigned char> p_edge;      //evidence each cell is an edge
+	std::vector<unsigned char> p_seen;      //what this frame saw in each cell (OCC_SAW_*)
+	std::vector<int> p_touched;             //cells this frame saw
+
+	//private methods
+private:
+	int cell_of(double meters);
+	int index(int cellX, int cellY);
+	void clear_column(int cellX);
+	void clear_row(int cellY);
+	void to_world(float side, float ahead, double *x, double *y);
+	int count_in(const std::vector<unsigned char> &evidence, float sideMin,
+			float sideMax, float aheadMin, float aheadMax);
+};
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "Predictor.hpp"
+#include "Scheduler.hpp"
+
+/****************************** Definitions **********************************/
+
+//alpha-beta filter gains for direction (higher follows the camera closer)
+#define PREDICT_ALPHA 0.6
+#define PREDICT_BETA 0.2
+//low pass filter gain for speed
+#define PREDICT_SPEED_ALPHA 0.5
+//low pass filter gain for measured latency
+#define PREDICT_LATENCY_ALPHA 0.1
+//time from sending a command until the servo acts on it (seconds)
+#define PREDICT_ACTUATION_DELAY 0.02
+//never extrapolate further than this past the measured latency (seconds),
+//hold the value instead
+#define PREDICT_MAX_HORIZON 0.15
+//limit how fast direction can be predicted to change (per second)
+#define PREDICT_MAX_DIR_RATE 400.0
+//a decision older than the latency plus this (a few frames at 30fps) is
+//stale, the vision loop has stopped (seconds)
+#define PREDICT_STALE_AFTER 0.1
+//time a stale decision's speed is ramped down to 0 over (seconds)
+#define PREDICT_STALE_RAMP 0.1
+
+/****************************** Implementation *******************************/
+
+Predictor::Predictor( void )
+{
+	reset();
+}
+
+void Predictor::reset( void )
+{
+	std::lock_guard<std::mutex> guard( p_lock );
+	p_valid = false;
+	p_frameTime = 0;
+	p_direction = 0;
+	p_dirRate = 0;
+	p_speed = 0;
+	p_latency = 0;
+	p_updates = 0;
+}
+
+//Add a new decision made from a frame captured at frameTime (seconds,
+//see Scheduler::now)
+void Predictor::update( int speed, int direction, double frameTime )
+{
+	double now = Scheduler::now();
+	std::lock_guard<std::mutex> guard( p_lock );
+
+	//keep track of how long the vision pipeline takes
+	double latency = now - frameTime;
+	if( latency < 0 )
+		latency = 0;
+	if( p_updates == 0 )
+		p_latency = latency;
+	else
+		p_latency += PREDICT_LATENCY_ALPHA * ( latency - p_latency );
+	p_updates++;
+
+	//first decision, or an old frame came in late. Just take it.
+	double dt = frameTime - p_frameTime;
+	if( !p_valid || dt <= 0 || dt > PREDICT_MAX_HORIZON * 4 ) {
+		p_direction = direction;
+		p_dirRate = 0;
+		p_speed = speed;
+		p_frameTime = frameTime;
+		p_valid = true;
+		return;
+	}
+
+	//alpha-beta filter on direction
+	double predicted = p_direction + p_dirRate * dt;
+	double residual = direction - predicted;
+	p_direction = predicted + PREDICT_ALPHA * residual;
+	p_dirRate += ( PREDICT_BETA * residual ) / dt;
+	if( p_dirRate > PREDICT_MAX_DIR_RATE )
+		p_dirRate = PREDICT_MAX_DIR_RATE;
+	else if( p_dirRate < -PREDICT_MAX_DIR_RATE )
+		p_dirRate = -PREDICT_MAX_DIR_RATE;
+
+	//speed only changes in steps, just smooth it (not from forward to
+	//reverse or back, halfway between is standing still)
+	if( ( speed > 0 && p_speed < 0 ) || ( speed < 0 && p_speed > 0 ) )
+		p_speed = speed;
+	else
+		p_speed += PREDICT_SPEED_ALPHA * ( speed - p_speed );
+	p_frameTime = frameTime;
+}
+
+//Get the speed and direction the truck should have when a command sent at
+//time now takes effect. If no decision has come in for a while the speed
+//ramps down to 0.
+void Predictor::predict( double now, int *speed, int *direction )
+{
+	std::lock_guard<std::mutex> guard( p_lock );
+
+	if( !p_valid ) {
+		*speed = 0;
+		*direction = 0;
+		return;
+	}
+
+	//extrapolate from the frame the decision was made on. By the time a
+	//decision exists the frame is already the pipeline latency old, so at
+	//least that far, and the cap only starts counting after it.
+	double horizon = now + PREDICT_ACTUATION_DELAY - p_frameTime;
+	if( horizon < p_latency )
+		horizon = p_latency;
+	else if( horizon > p_latency + PREDICT_MAX_HORIZON )
+		horizon = p_latency + PREDICT_MAX_HORIZON;
+	double dir = p_direction + p_dirRate * horizon;
+
+	if( dir > 100 )
+		dir = 100;
+	else if( dir < -100 )
+		dir = -100;
+
+	//stop if the vision loop has stopped deciding
+	double speedNow = p_speed;
+	double stale = now - p_frameTime - p_latency - PREDICT_STALE_AFTER;
+	if( stale >= PREDICT_STALE_RAMP )
+		speedNow = 0;
+	else if( stale > 0 )
+		speedNow *= 1.0 - stale / PREDICT_STALE_RAMP;
+
+	*direction = (int)( dir + ( dir < 0 ? -0.5 : 0.5 ) );
+	*speed = (int)( speedNow + ( speedNow < 0 ? -0.5 : 0.5 ) );
+}
+
+//Average time from frame capture until a decision comes out (seconds)
+double Predictor::latency( void )
+{
+	std::lock_guard<std::mutex> guard( p_lock );
+	return p_latency;
+}
+
+int Predictor::updates( void )
+{
+	std::lock_guard<std::mutex> guard( p_lock );
+	return p_updates;
+}
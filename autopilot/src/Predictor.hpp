@@ -0,0 +1,37 @@
+/******************************************************************************
+ * Predictor Class - Sits between Navigate and Truck. Filters the speed and
+ *                   direction decisions coming out of the vision loop and
+ *                   extrapolates the direction to the moment the command is
+ *                   actually sent, so the truck can be updated faster than
+ *                   the camera delivers frames.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <mutex>
+
+class Predictor {
+	//methods
+public:
+	Predictor();
+	void reset(void);
+	void update(int speed, int direction, double frameTime);
+	void predict(double now, int *speed, int *direction);
+	double latency(void);
+	int updates(void);
+
+	//private variables
+private:
+	std::mutex p_lock;
+	bool p_valid;
+	double p_frameTime;   //capture time of the last decision
+	double p_direction;   //filtered direction at p_frameTime
+	double p_dirRate;     //direction change per second
+	double p_speed;       //filtered speed
+	double p_latency;     //average capture to decision time
+	int p_updates;
+};
@@ -0,0 +1,258 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "Recorder.hpp"
+
+#include <iostream>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/****************************** Definitions **********************************/
+
+//index entries written before the index is flushed
+#define RECORD_FLUSH_FRAMES 30
+
+using std::cout;
+using std::endl;
+
+/****************************** Implementation *******************************/
+
+Recorder::Recorder( void )
+{
+	framesWritten = 0;
+	framesDropped = 0;
+	p_index = NULL;
+	p_segFd = -1;
+	p_segment = -1;
+	p_segFrames = 0;
+	p_queueHead = 0;
+	p_queueCount = 0;
+	p_stop = false;
+}
+
+Recorder::~Recorder( void )
+{
+	close();
+}
+
+//Start a recording in dir (made if it doesn't exist, an old recording in
+//it is replaced)
+bool Recorder::open( const std::string &dir, int width, int height, CAMERA_FORMAT_T format )
+{
+	close();
+	p_dir = dir;
+	mkdir( dir.c_str(), 0777 );
+	remove_segments();
+
+	int channels = ( format == CAMERA_FORMAT_YUYV ) ? 2 : 3;
+	p_header.magic = RECORD_MAGIC;
+	p_header.width = width;
+	p_header.height = height;
+	p_header.format = format;
+	p_header.frameBytes = width * height * channels;
+	p_header.framesPerSegment = RECORD_SEGMENT_BYTES / p_header.frameBytes;
+	if( p_header.framesPerSegment < 1 )
+		return false;
+
+	p_index = fopen( ( dir + "/" + RECORD_INDEX_NAME ).c_str(), "wb" );
+	if( p_index == NULL ) {
+		cout << "Error: Unable to write " << dir << "/" << RECORD_INDEX_NAME << endl;
+		return false;
+	}
+	fwrite( &p_header, sizeof(p_header), 1, p_index );
+
+	//every buffer up front, nothing is allocated while recording
+	int type = ( format == CAMERA_FORMAT_YUYV ) ? CV_8UC2 : CV_8UC3;
+	p_buffers.resize( RECORD_QUEUE_FRAMES );
+	p_entries.resize( RECORD_QUEUE_FRAMES );
+	p_free.clear();
+	p_free.reserve( RECORD_QUEUE_FRAMES );
+	p_queued.assign( RECORD_QUEUE_FRAMES, 0 );
+	p_queueHead = 0;
+	p_queueCount = 0;
+	for( int i = 0; i < RECORD_QUEUE_FRAMES; i++ ) {
+		p_buffers[i].create( height, width, type );
+		p_free.push_back( i );
+	}
+
+	p_segment = -1;
+	p_segFrames = 0;
+	if( !next_segment() ) {
+		close();
+		return false;
+	}
+
+	framesWritten = 0;
+	framesDropped = 0;
+	p_stop = false;
+	p_thread = std::thread( &Recorder::writer, this );
+	return true;
+}
+
+//Write out what's queued and finish the files
+void Recorder::close( void )
+{
+	if( p_thread.joinable() ) {
+		{
+			std::lock_guard<std::mutex> guard( p_lock );
+			p_stop = true;
+		}
+		p_work.notify_one();
+		p_thread.join();
+	}
+
+	end_segment();
+	if( p_index != NULL ) {
+		fclose( p_index );
+		p_index = NULL;
+	}
+}
+
+//Copy a frame into the queue for the writer thread. Returns false (and
+//drops the frame) if the queue is full or the frame doesn't match.
+bool Recorder::push( const CAMERA_FRAME_T &frame )
+{
+	if( p_index == NULL || frame.format != p_header.format ||
+			frame.image.cols != p_header.width || frame.image.rows != p_header.height ) {
+		framesDropped++;
+		return false;
+	}
+
+	int buffer;
+	{
+		std::lock_guard<std::mutex> guard( p_lock );
+		if( p_free.empty() ) {
+			framesDropped++;
+			return false;
+		}
+		buffer = p_free.back();
+		p_free.pop_back();
+	}
+
+	//the copy happens outside the lock, the buffer is ours until queued
+	frame.image.copyTo( p_buffers[buffer] );
+	p_entries[buffer].time = frame.time;
+	p_entries[buffer].sequence = frame.sequence;
+
+	{
+		std::lock_guard<std::mutex> guard( p_lock );
+		p_queued[( p_queueHead + p_queueCount ) % RECORD_QUEUE_FRAMES] = buffer;
+		p_queueCount++;
+	}
+	p_work.notify_one();
+	return true;
+}
+
+void Recorder::writer( void )
+{
+	while( true ) {
+		int buffer;
+		{
+			std::unique_lock<std::mutex> lock( p_lock );
+			p_work.wait( lock, [this] { return p_stop || p_queueCount > 0; } );
+			if( p_queueCount == 0 ) {
+				//stopping, and everything is written
+				return;
+			}
+			buffer = p_queued[p_queueHead];
+			p_queueHead = ( p_queueHead + 1 ) % RECORD_QUEUE_FRAMES;
+			p_queueCount--;
+		}
+
+		write_frame( buffer );
+
+		std::lock_guard<std::mutex> guard( p_lock );
+		p_free.push_back( buffer );
+	}
+}
+
+//Write a queued frame to the segment and index. A frame that can't be
+//written counts as dropped.
+bool Recorder::write_frame( int buffer )
+{
+	if( p_segFrames == p_header.framesPerSegment && !next_segment() ) {
+		framesDropped++;
+		return false;
+	}
+
+	RECORD_ENTRY_T &entry = p_entries[buffer];
+	entry.segment = p_segment;
+	entry.offset = p_segFrames * p_header.frameBytes;
+	if( pwrite( p_segFd, p_buffers[buffer].data, p_header.frameBytes, entry.offset ) !=
+			p_header.frameBytes ) {
+		cout << "Error: Unable to write frame " << entry.sequence << endl;
+		framesDropped++;
+		return false;
+	}
+	p_segFrames++;
+
+	fwrite( &entry, sizeof(entry), 1, p_index );
+	framesWritten++;
+	if( framesWritten % RECORD_FLUSH_FRAMES == 0 )
+		fflush( p_index );
+	return true;
+}
+
+//Close the segment being written and start the next one at full size
+bool Recorder::next_segment( void )
+{
+	end_segment();
+	p_segment++;
+	p_segFrames = 0;
+
+	char name[32];
+	snprintf( name, sizeof(name), RECORD_SEGMENT_NAME, p_segment );
+	std::string path = p_dir + "/" + name;
+	p_segFd = ::open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+	if( p_segFd < 0 ) {
+		cout << "Error: Unable to write " << path << endl;
+		return false;
+	}
+
+	//claim the disk space now so writing never has to
+	off_t bytes = (off_t)p_header.framesPerSegment * p_header.frameBytes;
+	if( posix_fallocate( p_segFd, 0, bytes ) != 0 )
+		cout << "Warning: Unable to preallocate " << path << endl;
+	return true;
+}
+
+//Delete every segment file in the directory, a longer recording made there
+//before would otherwise leave its later segments behind
+void Recorder::remove_segments( void )
+{
+	DIR *d = opendir( p_dir.c_str() );
+	if( d == NULL )
+		return;
+
+	struct dirent *entry;
+	while( ( entry = readdir( d ) ) != NULL ) {
+		//only names we'd have written
+		int segment;
+		char name[32];
+		if( sscanf( entry->d_name, "segment_%d", &segment ) != 1 )
+			continue;
+		snprintf( name, sizeof(name), RECORD_SEGMENT_NAME, segment );
+		if( strcmp( name, entry->d_name ) == 0 )
+			unlink( ( p_dir + "/" + name ).c_str() );
+	}
+	closedir( d );
+}
+
+//Trim the unused end of the segment
+void Recorder::end_segment( void )
+{
+	if( p_segFd < 0 )
+		return;
+	if( ftruncate( p_segFd, (off_t)p_segFrames * p_header.frameBytes ) < 0 )
+		cout << "Warning: Unable to trim segment " << p_segment << endl;
+	::close( p_segFd );
+	p_segFd = -1;
+}
@@ -0,0 +1,100 @@
+/******************************************************************************
+ * Recorder Class - Records raw frames to a directory of preallocated segment
+ *                  files from its own thread, with an index of every frame's
+ *                  time and where it is. The capture loop only copies the
+ *                  frame into a free queue buffer (or drops it if the disk
+ *                  can't keep up), it never waits on the disk.
+ *
+ *                  Recordings are played back with Recording.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Camera.hpp"
+
+/****************************** Definitions **********************************/
+
+/** Size each segment file is preallocated to */
+#define RECORD_SEGMENT_BYTES (64 * 1024 * 1024)
+/** Frames that can wait for the disk before new ones are dropped */
+#define RECORD_QUEUE_FRAMES 16
+
+#define RECORD_MAGIC 0x52445452
+#define RECORD_INDEX_NAME "index.bin"
+#define RECORD_SEGMENT_NAME "segment_%04d.raw"
+
+/** Start of the index file */
+typedef struct RECORD_HEADER_S {
+	uint32_t magic;
+	int32_t width;
+	int32_t height;
+	int32_t format;          //CAMERA_FORMAT_T
+	int32_t frameBytes;
+	int32_t framesPerSegment;
+} RECORD_HEADER_T;
+
+/** One index entry per frame */
+typedef struct RECORD_ENTRY_S {
+	double time;
+	int64_t sequence;
+	int32_t segment;
+	int32_t offset;          //bytes into the segment
+} RECORD_ENTRY_T;
+
+class Recorder {
+	//variables
+public:
+	long framesWritten;
+	std::atomic<long> framesDropped;  //queue was full or the disk write failed
+
+	//methods
+public:
+	Recorder();
+	~Recorder();
+	bool open(const std::string &dir, int width, int height, CAMERA_FORMAT_T format);
+	void close(void);
+	bool push(const CAMERA_FRAME_T &frame);
+
+	//private variables
+private:
+	std::string p_dir;
+	RECORD_HEADER_T p_header;
+	FILE *p_index;
+	int p_segFd;
+	int p_segment;
+	int p_segFrames;         //frames in the current segment
+	std::vector<cv::Mat> p_buffers;
+	std::vector<RECORD_ENTRY_T> p_entries;  //time and sequence of each buffer
+	std::vector<int> p_free;
+	std::vector<int> p_queued;  //ring of buffers waiting for the disk
+	int p_queueHead;
+	int p_queueCount;
+	std::mutex p_lock;
+	std::condition_variable p_work;
+	bool p_stop;
+	std::thread p_thread;
+
+	//private methods
+private:
+	Recorder(const Recorder &);
+	Recorder &operator=(const Recorder &);
+	void writer(void);
+	bool write_frame(int buffer);
+	bool next_segment(void);
+	void end_segment(void);
+	void remove_segments(void);
+};
@@ -0,0 +1,141 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "Recording.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/****************************** Definitions **********************************/
+
+using std::cout;
+using std::endl;
+
+/****************************** Implementation *******************************/
+
+Recording::Recording( void )
+{
+	p_header.magic = 0;
+}
+
+Recording::~Recording( void )
+{
+	close();
+}
+
+//Read the index and map every segment
+bool Recording::open( const std::string &dir )
+{
+	close();
+
+	FILE *index = fopen( ( dir + "/" + RECORD_INDEX_NAME ).c_str(), "rb" );
+	if( index == NULL )
+		return false;
+	if( fread( &p_header, sizeof(p_header), 1, index ) != 1 || p_header.magic != RECORD_MAGIC ) {
+		cout << "Error: " << dir << " is not a recording" << endl;
+		fclose( index );
+		return false;
+	}
+	RECORD_ENTRY_T entry;
+	while( fread( &entry, sizeof(entry), 1, index ) == 1 )
+		p_index.push_back( entry );
+	fclose( index );
+
+	int segments = p_index.empty() ? 0 : p_index.back().segment + 1;
+	p_segments.assign( segments, (unsigned char *)NULL );
+	p_segBytes.assign( segments, 0 );
+	for( int s = 0; s < segments; s++ ) {
+		char name[32];
+		snprintf( name, sizeof(name), RECORD_SEGMENT_NAME, s );
+		std::string path = dir + "/" + name;
+		int fd = ::open( path.c_str(), O_RDONLY );
+		struct stat st;
+		if( fd < 0 || fstat( fd, &st ) < 0 || st.st_size == 0 ) {
+			cout << "Error: Unable to read " << path << endl;
+			if( fd >= 0 )
+				::close( fd );
+			close();
+			return false;
+		}
+
+		//private so whoever gets a frame can't change the file
+		void *mem = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+		::close( fd );
+		if( mem == MAP_FAILED ) {
+			close();
+			return false;
+		}
+		p_segments[s] = (unsigned char *)mem;
+		p_segBytes[s] = st.st_size;
+	}
+
+	//a recording cut short may index frames that never made it to disk
+	while( !p_index.empty() ) {
+		const RECORD_ENTRY_T &last = p_index.back();
+		if( (size_t)last.offset + p_header.frameBytes <= p_segBytes[last.segment] )
+			break;
+		p_index.pop_back();
+	}
+	return true;
+}
+
+void Recording::close( void )
+{
+	for( size_t s = 0; s < p_segments.size(); s++ )
+		if( p_segments[s] != NULL )
+			munmap( p_segments[s], p_segBytes[s] );
+	p_segments.clear();
+	p_segBytes.clear();
+	p_index.clear();
+}
+
+long Recording::frames( void )
+{
+	return (long)p_index.size();
+}
+
+//Frame by number, in place in the mapped segment
+bool Recording::frame( long index, CAMERA_FRAME_T *frame )
+{
+	frame->lease.reset();
+	frame->image.release();
+	if( index < 0 || index >= (long)p_index.size() )
+		return false;
+
+	const RECORD_ENTRY_T &entry = p_index[index];
+	int type = ( p_header.format == CAMERA_FORMAT_YUYV ) ? CV_8UC2 : CV_8UC3;
+	frame->image = cv::Mat( p_header.height, p_header.width, type,
+			p_segments[entry.segment] + entry.offset );
+	frame->format = (CAMERA_FORMAT_T)p_header.format;
+	frame->time = entry.time;
+	frame->sequence = (long)entry.sequence;
+	return true;
+}
+
+//First frame at or after time (frames() if none)
+long Recording::find( double time )
+{
+	std::vector<RECORD_ENTRY_T>::iterator it = std::lower_bound( p_index.begin(), p_index.end(),
+			time, []( const RECORD_ENTRY_T &e, double t ) { return e.time < t; } );
+	return (long)( it - p_index.begin() );
+}
+
+double Recording::start_time( void )
+{
+	return p_index.empty() ? 0 : p_index.front().time;
+}
+
+double Recording::end_time( void )
+{
+	return p_index.empty() ? 0 : p_index.back().time;
+}
@@ -0,0 +1,45 @@
+/******************************************************************************
+ * Recording Class - Plays back a Recorder recording. Segments are memory
+ *                   mapped and the index says where every frame is, so any
+ *                   frame (by number or by time) is available straight away
+ *                   without reading the ones before it.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+#include <vector>
+#include <string>
+
+#include "Camera.hpp"
+#include "Recorder.hpp"
+
+class Recording {
+	//methods
+public:
+	Recording();
+	~Recording();
+	bool open(const std::string &dir);
+	void close(void);
+	long frames(void);
+	bool frame(long index, CAMERA_FRAME_T *frame);
+	long find(double time);
+	double start_time(void);
+	double end_time(void);
+
+	//private variables
+private:
+	RECORD_HEADER_T p_header;
+	std::vector<RECORD_ENTRY_T> p_index;
+	std::vector<unsigned char *> p_segments;
+	std::vector<size_t> p_segBytes;
+
+	//private methods
+private:
+	Recording(const Recording &);
+	Recording &operator=(const Recording &);
+};
@@ -0,0 +1,208 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "Scheduler.hpp"
+
+#include <iostream>
+#include <sched.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/****************************** Definitions **********************************/
+
+#define NS_PER_SEC 1000000000LL
+#define NS_PER_US 1000.0
+#define SCHED_DEFAULT_RATE_HZ 30
+
+using std::cout;
+using std::endl;
+
+/****************************** Implementation *******************************/
+
+Scheduler::Scheduler( void )
+{
+	set_rate( SCHED_DEFAULT_RATE_HZ );
+	reset_stats();
+}
+
+void Scheduler::set_rate( int hz )
+{
+	if( hz <= 0 )
+		hz = SCHED_DEFAULT_RATE_HZ;
+	p_periodNs = NS_PER_SEC / hz;
+}
+
+bool Scheduler::set_realtime( int priority )
+{
+	struct sched_param param;
+	memset( &param, 0, sizeof param );
+	param.sched_priority = priority;
+
+	int err = pthread_setschedparam( pthread_self(), SCHED_FIFO, &param );
+	if( err != 0 ) {
+		cout << "Scheduler Error: Couldn't set SCHED_FIFO: " << strerror( err ) << endl;
+		return false;
+	}
+	return true;
+}
+
+bool Scheduler::clear_realtime( void )
+{
+	struct sched_param param;
+	memset( &param, 0, sizeof param );
+	return ( pthread_setschedparam( pthread_self(), SCHED_OTHER, &param ) == 0 );
+}
+
+void Scheduler::start( void )
+{
+	reset_stats();
+	clock_gettime( CLOCK_MONOTONIC, &p_next );
+	add_ns( &p_next, p_periodNs );
+}
+
+//Call once per loop iteration, after the work is done. Sleeps until the start
+//of the next period. Returns false if the work overran its deadline.
+bool Scheduler::wait_next_period( void )
+{
+	struct timespec now;
+	bool onTime = true;
+
+	periods++;
+
+	//check if we made it before the end of this period
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	long long late = diff_ns( now, p_next );
+	if( late > 0 ) {
+		onTime = false;
+		deadlineMisses++;
+		if( late / NS_PER_US > overrunMaxUs )
+			overrunMaxUs = late / NS_PER_US;
+		//skip the periods we missed instead of trying to catch up
+		long long missed = late / p_periodNs + 1;
+		add_ns( &p_next, missed * p_periodNs );
+	}
+
+	//sleep until the start of the next period
+	while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &p_next, NULL ) == EINTR );
+
+	//measure how late we woke up
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	double jitterUs = diff_ns( now, p_next ) / NS_PER_US;
+	if( jitterUs < 0 )
+		jitterUs = 0;
+	if( jitterUs > jitterMaxUs )
+		jitterMaxUs = jitterUs;
+	p_jitterSumUs += jitterUs;
+	jitterAvgUs = p_jitterSumUs / periods;
+
+	//this period's deadline is the start of the next one
+	add_ns( &p_next, p_periodNs );
+
+	return onTime;
+}
+
+void Scheduler::reset_stats( void )
+{
+	periods = 0;
+	deadlineMisses = 0;
+	jitterMaxUs = 0;
+	jitterAvgUs = 0;
+	overrunMaxUs = 0;
+	p_jitterSumUs = 0;
+}
+
+void Scheduler::print_stats( const char *name )
+{
+	cout << name << " loop: " << periods << " periods, "
+		<< deadlineMisses << " deadline misses" << endl;
+	cout << "  period     : " << p_periodNs / NS_PER_US << " us" << endl;
+	cout << "  jitter avg : " << jitterAvgUs << " us" << endl;
+	cout << "  jitter max : " << jitterMaxUs << " us" << endl;
+	cout << "  overrun max: " << overrunMaxUs << " us" << endl;
+}
+
+bool Scheduler::pin_thread( pthread_t thread, int core )
+{
+	if( core == SCHED_CORE_ANY )
+		return true;
+
+	//make sure the core actually exists on this machine
+	if( core >= sysconf( _SC_NPROCESSORS_ONLN ) ) {
+		cout << "Scheduler: core " << core << " not available, not pinning" << endl;
+		return false;
+	}
+
+	cpu_set_t cpus;
+	CPU_ZERO( &cpus );
+	CPU_SET( core, &cpus );
+	int err = pthread_setaffinity_np( thread, sizeof cpus, &cpus );
+	if( err != 0 ) {
+		cout << "Scheduler Error: Couldn't pin to core " << core << ": "
+			<< strerror( err ) << endl;
+		return false;
+	}
+	return true;
+}
+
+bool Scheduler::pin_current_thread( int core )
+{
+	return pin_thread( pthread_self(), core );
+}
+
+//Cores the calling thread may run on, to put back after pinning it
+bool Scheduler::get_current_affinity( cpu_set_t *cpus )
+{
+	CPU_ZERO( cpus );
+	return ( pthread_getaffinity_np( pthread_self(), sizeof *cpus, cpus ) == 0 );
+}
+
+bool Scheduler::set_current_affinity( const cpu_set_t &cpus )
+{
+	int err = pthread_setaffinity_np( pthread_self(), sizeof cpus, &cpus );
+	if( err != 0 ) {
+		cout << "Scheduler Error: Couldn't restore affinity: " << strerror( err ) << endl;
+		return false;
+	}
+	return true;
+}
+
+bool Scheduler::lock_memory( void )
+{
+	//lock current and future pages so the control loop never page faults
+	if( mlockall( MCL_CURRENT | MCL_FUTURE ) != 0 ) {
+		cout << "Scheduler Error: mlockall failed: " << strerror( errno ) << endl;
+		return false;
+	}
+	return true;
+}
+
+//Monotonic time in seconds, used to timestamp frames and decisions
+double Scheduler::now( void )
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return (double)t.tv_sec + (double)t.tv_nsec / NS_PER_SEC;
+}
+
+void Scheduler::add_ns( struct timespec *t, long long ns )
+{
+	t->tv_sec += ns / NS_PER_SEC;
+	t->tv_nsec += ns % NS_PER_SEC;
+	if( t->tv_nsec >= NS_PER_SEC ) {
+		t->tv_nsec -= NS_PER_SEC;
+		t->tv_sec++;
+	}
+}
+
+//returns a - b in nanoseconds
+long long Scheduler::diff_ns( const struct timespec &a, const struct timespec &b )
+{
+	return ( a.tv_sec - b.tv_sec ) * NS_PER_SEC + ( a.tv_nsec - b.tv_nsec );
+}
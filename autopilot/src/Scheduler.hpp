@@ -0,0 +1,62 @@
+/******************************************************************************
+ * Scheduler Class - Runs a loop at a fixed rate. It can optionally switch the
+ *                   calling thread to SCHED_FIFO, pin threads to cores and
+ *                   lock memory. Missed deadlines and wake-up jitter are
+ *                   tracked so we can see how predictable the loop is.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <pthread.h>
+#include <time.h>
+
+/****************************** Definitions **********************************/
+
+/** Odroid XU4 cores: 0-3 are the LITTLE (A7) cores, 4-7 are the big (A15) */
+#define SCHED_CORE_ANY -1
+#define SCHED_CORE_CAPTURE 5
+#define SCHED_CORE_VISION 4
+#define SCHED_CORE_SERIAL 6
+#define SCHED_CORE_WORKERS 7
+
+class Scheduler {
+	//variables
+public:
+	long periods;
+	long deadlineMisses;
+	double jitterMaxUs;
+	double jitterAvgUs;
+	double overrunMaxUs;
+
+	//methods
+public:
+	Scheduler();
+	void set_rate(int hz);
+	bool set_realtime(int priority);
+	bool clear_realtime(void);
+	void start(void);
+	bool wait_next_period(void);
+	void reset_stats(void);
+	void print_stats(const char *name);
+	static bool pin_thread(pthread_t thread, int core);
+	static bool pin_current_thread(int core);
+	static bool get_current_affinity(cpu_set_t *cpus);
+	static bool set_current_affinity(const cpu_set_t &cpus);
+	static bool lock_memory(void);
+	static double now(void);
+
+	//private variables
+private:
+	long p_periodNs;
+	struct timespec p_next;
+	double p_jitterSumUs;
+
+	//private methods
+private:
+	static void add_ns(struct timespec *t, long long ns);
+	static long long diff_ns(const struct timespec &a, const struct timespec &b);
+};
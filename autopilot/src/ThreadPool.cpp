@@ -0,0 +1,107 @@
+/******************************************************************************
+ * Class Implementation
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+/****************************** Include Files ********************************/
+
+#include "ThreadPool.hpp"
+#include "Scheduler.hpp"
+
+/****************************** Implementation *******************************/
+
+ThreadPool::ThreadPool( void )
+{
+	p_busy = 0;
+	p_stop = false;
+}
+
+ThreadPool::~ThreadPool( void )
+{
+	stop();
+}
+
+//Start the workers. Worker i is pinned to firstCore + i unless firstCore is
+//SCHED_CORE_ANY.
+void ThreadPool::start( int workers, int firstCore )
+{
+	stop();
+
+	p_stop = false;
+	for( int i = 0; i < workers; i++ ) {
+		int core = SCHED_CORE_ANY;
+		if( firstCore != SCHED_CORE_ANY )
+			core = firstCore + i;
+		p_threads.push_back( std::thread( &ThreadPool::worker, this, core ) );
+	}
+}
+
+//Finish queued tasks and join the workers
+void ThreadPool::stop( void )
+{
+	{
+		std::lock_guard<std::mutex> guard( p_lock );
+		p_stop = true;
+	}
+	p_work.notify_all();
+
+	for( int i = 0; i < (int)p_threads.size(); i++ )
+		p_threads.at(i).join();
+	p_threads.clear();
+}
+
+int ThreadPool::workers( void )
+{
+	return (int)p_threads.size();
+}
+
+void ThreadPool::submit( std::function<void()> task )
+{
+	//no workers, just run it here
+	if( p_threads.empty() ) {
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard( p_lock );
+		p_tasks.push_back( task );
+	}
+	p_work.notify_one();
+}
+
+//Wait until every submitted task has finished
+void ThreadPool::wait_idle( void )
+{
+	std::unique_lock<std::mutex> guard( p_lock );
+	while( !p_tasks.empty() || p_busy != 0 )
+		p_idle.wait( guard );
+}
+
+void ThreadPool::worker( int core )
+{
+	Scheduler::pin_current_thread( core );
+
+	std::unique_lock<std::mutex> guard( p_lock );
+	while( 1 ) {
+		//wait for something to do
+		while( p_tasks.empty() && !p_stop )
+			p_work.wait( guard );
+		if( p_tasks.empty() && p_stop )
+			break;
+
+		std::function<void()> task = p_tasks.front();
+		p_tasks.pop_front();
+		p_busy++;
+
+		//run it without holding the lock
+		guard.unlock();
+		task();
+		guard.lock();
+
+		p_busy--;
+		if( p_tasks.empty() && p_busy == 0 )
+			p_idle.notify_all();
+	}
+}
@@ -0,0 +1,45 @@
+/******************************************************************************
+ * ThreadPool Class - A fixed set of worker threads that run queued tasks.
+ *                    Threads are created once at start, never per frame.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class ThreadPool {
+	//methods
+public:
+	ThreadPool();
+	~ThreadPool();
+	void start(int workers, int firstCore);
+	void stop(void);
+	int workers(void);
+	void submit(std::function<void()> task);
+	void wait_idle(void);
+
+	//private variables
+private:
+	std::vector<std::thread> p_threads;
+	std::deque< std::function<void()> > p_tasks;
+	std::mutex p_lock;
+	std::condition_variable p_work;
+	std::condition_variable p_idle;
+	int p_busy;
+	bool p_stop;
+
+	//private methods
+private:
+	ThreadPool(const ThreadPool &);
+	ThreadPool &operator=(const ThreadPool &);
+	void worker(int core);
+};
@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Tree Classifier - Labels pixels free, course edge or obstacle with a
+ *                   decision tree. Generated by tree_train, don't edit by
+ *                   hand, train it again instead.
+ *
+ *                   Placeholder until tree_train is run on labelled frames:
+ *                   everything is free.
+ *
+ * Authors: James Swift, Luke Newmeyer
+ * Copyright 2017
+ *****************************************************************************/
+#pragma once
+
+/****************************** Include Files ********************************/
+
+#include <opencv2/core.hpp>
+
+/****************************** Definitions **********************************/
+
+#define TREE_DEPTH 1
+#define TREE_FREE 0
+#define TREE_EDGE 1
+#define TREE_OBSTACLE 2
+
+//feature each node splits on: B, G, R, B-G, G-R, R-B
+static const unsigned char TREE_FEATURE[1] = { 0 };
+//go right when the feature is above this
+static const short TREE_THRESHOLD[1] = { 255 };
+//class of each leaf
+static const unsigned char TREE_LEAF[2] = { 0, 0 };
+
+/****************************** Implementation *******************************/
+
+//Fill the obstacle and edge masks (which may be views into bigger masks)
+static inline void tree_classify(cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges)
+{
+	frameObstacles->create(frame.size(), CV_8UC1);
+	frameEdges->create(frame.size(), CV_8UC1);
+
+	for (int y = 0; y < frame.rows; y++) {
+		const uchar *px = frame.ptr<uchar>(y);
+		uchar *obs = frameObstacles->ptr<uchar>(y);
+		uchar *edge = frameEdges->ptr<uchar>(y);
+		for (int x = 0; x < frame.cols; x++, px += 3) {
+			const short f[6] = { px[0], px[1], px[2],
+				(short)(px[0] - px[1]), (short)(px[1] - px[2]), (short)(px[2] - px[0]) };
+			int n = 0;
+			n = 2 * n + 1 + (f[TREE_FEATURE[n]] > TREE_THRESHOLD[n]);
+			int cls = TREE_LEAF[n - 1];
+			obs[x] = (uchar)-(cls == TREE_OBSTACLE);
+			edge[x] = (uchar)-(cls == TREE_EDGE);
+		}
+	}
+}
@@ -8,10 +8,15 @@
 #include "Truck.hpp"
 #include "Camera.hpp"
 #include "Navigate.hpp"
+#include "Scheduler.hpp"
+#include "Predictor.hpp"
+#include "Calibrator.hpp"
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <iostream>
+#include <thread>
+#include <atomic>
 //#include <unistd.h>
 //#include <termios.h>
 
@@ -29,6 +34,32 @@
 #define KEY_RECORD_VIDEO_VERBOSE 'z'
 #define KEY_ESCAPE 27
 
+/** Keys in calibrate mode */
+#define KEY_CAL_OBSTACLE 'o'
+#define KEY_CAL_EDGE 'e'
+#define KEY_CAL_AUTO 'a'
+#define KEY_CAL_APPLY 'c'
+#define KEY_CAL_ENTER 13
+/** Frames sampled by one auto calibrate */
+#define CALIBRATE_AUTO_FRAMES 10
+
+/** Vision loop rate in Hz (camera runs at 30fps) */
+#define AUTO_DRIVE_RATE_HZ 30
+/** Rate commands are sent to the truck in Hz (predicted between frames) */
+#define ACTUATE_RATE_HZ 60
+/** Time the planner gets per frame before it uses its coarse route (0 = off) */
+#define AUTO_DRIVE_PLAN_BUDGET_US 20000
+/** Threads classifying bands of each frame (0 = inline, see nav_bench). The
+ * XU4's only big core without a thread of ours is SCHED_CORE_WORKERS, more
+ * workers would have to share with capture or serial */
+#define AUTO_DRIVE_CLASSIFY_WORKERS 1
+/** Route engine: NAV_ENGINE_GREEDY, _MULTI (uses the workers) or _DP */
+#define AUTO_DRIVE_ENGINE NAV_ENGINE_GREEDY
+/** Uncomment to run the control loop as SCHED_FIFO with this priority (root) */
+//#define AUTO_DRIVE_FIFO_PRIORITY 50
+/** Uncomment to lock all memory with mlockall (root) */
+//#define AUTO_DRIVE_LOCK_MEMORY
+
 /** Main state machine */
 typedef enum MAIN_STATE_E {
     MAIN_STATE_IDLE = 0,
@@ -46,6 +77,8 @@ using std::endl;
 static Camera m_camera;
 static Navigate m_nav;
 static Truck m_truck;
+static Predictor m_predictor;
+static std::atomic<bool> m_actuating;
 
 /****************************** Private Functions **************************/
 
@@ -58,6 +91,10 @@ static void main_auto_drive( void );
 /** Calibrate mode */
 static void main_calibrate_drive( void );
 static void main_report_nav( void );
+/** When a frame was captured, on the Scheduler::now clock */
+static double main_frame_time( const CAMERA_FRAME_T &frame );
+/** Sends predicted commands to the truck at a fixed rate (own thread) */
+static void main_actuate( void );
 
 /****************************** Implementation *****************************/
 
@@ -68,9 +105,44 @@ int main()
     //print usage
     main_print_usage();
 
+#ifdef AUTO_DRIVE_LOCK_MEMORY
+	//keep everything resident so the control loop never page faults
+	Scheduler::lock_memory();
+#endif
+
     //open camera
     m_camera.open();
 
+	//plan near rows at low resolution when the camera gives us big frames
+	m_nav.pyramidMode = true;
+	m_nav.set_workers( AUTO_DRIVE_CLASSIFY_WORKERS, SCHED_CORE_WORKERS );
+	m_nav.routeEngine = AUTO_DRIVE_ENGINE;
+	//start each frame's route walk from the last frame's gaps
+	m_nav.temporalMode = true;
+	//reuse the last decision while the scene sits still (idle, slow backup)
+	m_nav.skipMode = true;
+	//find gaps with lookups in a per frame clearance map (not with temporalMode:
+	//the map waits for every band to be classified and replaces last frame's
+	//gaps, so turning it on turns both of those off)
+	//m_nav.clearanceMode = true;
+	//multi engine routes lose score for obstacles ahead of the wheels (only
+	//with AUTO_DRIVE_ENGINE NAV_ENGINE_MULTI)
+	//m_nav.integralMode = true;
+	//truck width from the camera calibration (measure GroundMap's defaults first)
+	//m_nav.groundMode = true;
+	//and remember obstacles after they leave the view (needs groundMode)
+	//m_nav.occupancyMode = true;
+	//follow cones between frames instead of waiting out mask flicker
+	m_nav.blobMode = true;
+	//fit the course edges so a broken or noisy edge mask doesn't end the route
+	//(lets the walk cross edge pixels, leave off until it's been tried on the course)
+	//m_nav.edgeModelMode = true;
+	//classify with the tree from tree_train instead of the HSV boxes
+	//m_nav.treeMode = true;
+	//classify with a colour table (rebuilt in the background after calibrating)
+	m_nav.lutMode = true;
+	m_nav.rebuild_classifier();
+
     //connect to the truck
     m_truck.connect_truck();
 
@@ -166,9 +238,9 @@ int main()
                 break;
 
             case MAIN_STATE_CALIBRATE:
-                //main_calibrate_drive();
-				cout << "Calibrate not implemented." << endl;
-				cout << "Returning to idle." << endl;
+                main_calibrate_drive();
+                //when we exit, immediately change state
+				cout << "Entering Idle state." << endl;
 				state = MAIN_STATE_IDLE;
                 break;
         }
@@ -246,28 +318,167 @@ static void main_auto_drive( void )
 	//open a window (we can't get key presses without a window open)
 	cv::namedWindow("main", CV_WINDOW_KEEPRATIO);
 
-	//analyze camera frame
-	cv::Mat frame = m_camera.get_frame();
+	//run the control loop at a fixed rate on the vision core
+	Scheduler sched;
+	sched.set_rate( AUTO_DRIVE_RATE_HZ );
+	cpu_set_t prevCores;
+	bool restoreCores = Scheduler::get_current_affinity( &prevCores );
+	Scheduler::pin_current_thread( SCHED_CORE_VISION );
+#ifdef AUTO_DRIVE_FIFO_PRIORITY
+	sched.set_realtime( AUTO_DRIVE_FIFO_PRIORITY );
+#endif
+
+	//always have a steering decision ready before the period ends
+	m_nav.planBudgetUs = AUTO_DRIVE_PLAN_BUDGET_US;
+
+	//the truck is only talked to from the actuation thread from here on
+	m_predictor.reset();
+	m_actuating = true;
+	std::thread actuator( main_actuate );
+
+	//analyze camera frame (YUYV straight from the driver when we have one,
+	//Navigate only decodes it for the debug window)
+	CAMERA_FRAME_T frame;
+	m_camera.grab( &frame );
+	double frameTime = main_frame_time( frame );
 
 	//wait for user to press escape
 	int bailCnt = 0;
-	while(cv::waitKey(1) != KEY_ESCAPE && !frame.empty() ) {
+	sched.start();
+	while(cv::waitKey(1) != KEY_ESCAPE && !frame.image.empty() ) {
 		//analyze frame
 		cout << "pre Analyze." << endl;
-		m_nav.analyze_frame(frame);
+		m_nav.analyze_frame(frame.image);
 		cout << "post Analyze." << endl;
 
-		//update truck
-		m_truck.set_drive( m_nav.speed );
-		m_truck.set_steering( m_nav.direction );
+		//hand decision to the actuation thread
+		m_predictor.update( m_nav.speed, m_nav.direction, frameTime );
 
-		//get next frame
-		frame = m_camera.get_frame();
+		//wait for the start of the next control period
+		sched.wait_next_period();
+
+		//get next frame (this one's buffer goes back to the driver)
+		m_camera.grab( &frame );
+		frameTime = main_frame_time( frame );
 	}
+
+	//stop actuating
+	m_actuating = false;
+	actuator.join();
+
+	//give the last frame back to the camera
+	frame.image.release();
+	frame.lease.reset();
+
+#ifdef AUTO_DRIVE_FIFO_PRIORITY
+	sched.clear_realtime();
+#endif
+	//manual, calibrate and idle run wherever they like again
+	if( restoreCores )
+		Scheduler::set_current_affinity( prevCores );
+	sched.print_stats( "Auto drive" );
+	cout << "Pipeline latency: " << m_predictor.latency() * 1000.0 << " ms" << endl;
+	cout << "Rows reused from last frame: " << m_nav.cacheRowsHit << ", rescanned: "
+		<< m_nav.cacheRowsScanned << endl;
+	cout << "Frames analyzed: " << m_nav.framesAnalyzed << ", skipped: "
+		<< m_nav.framesSkipped << endl;
+	cout << "Camera frames still leased: " << m_camera.in_flight() << ", grabs with no free buffer: "
+		<< m_camera.leaseFailures << endl;
+}
+
+static void main_actuate( void )
+{
+	Scheduler sched;
+	sched.set_rate( ACTUATE_RATE_HZ );
+	Scheduler::pin_current_thread( SCHED_CORE_SERIAL );
+#ifdef AUTO_DRIVE_FIFO_PRIORITY
+	//steering has to go out on time, run above the vision loop
+	sched.set_realtime( AUTO_DRIVE_FIFO_PRIORITY + 1 );
+#endif
+
+	int lastSpeed = 0;
+	sched.start();
+	while( m_actuating ) {
+		int speed;
+		int direction;
+		m_predictor.predict( Scheduler::now(), &speed, &direction );
+
+		//steering every period, drive only when it changes
+		m_truck.set_steering( direction );
+		if( speed != lastSpeed ) {
+			m_truck.set_drive( speed );
+			lastSpeed = speed;
+		}
+
+		sched.wait_next_period();
+	}
+
+	sched.print_stats( "Actuate" );
 }
 
 static void main_calibrate_drive( void )
 {
+	Calibrator calibrator;
+
+	printf( "Calibrate: pick colours off the live camera\n" );
+	printf( "  %c - Select a cone\n", KEY_CAL_OBSTACLE );
+	printf( "  %c - Select a piece of course edge\n", KEY_CAL_EDGE );
+	printf( "  %c - Auto detect near the current colours\n", KEY_CAL_AUTO );
+	printf( "  %c - Apply and return (Enter works too)\n", KEY_CAL_APPLY );
+	printf( "  Esc - Return without changing anything\n" );
+
+	//show frames until the user picks something
+	char c = 0;
+	while( c != KEY_ESCAPE ) {
+		cv::Mat frame = m_camera.get_frame();
+		if( frame.empty() )
+			break;
+		cv::imshow( "main", frame );
+		c = cv::waitKey(1);
+
+		switch( c ) {
+			case KEY_CAL_OBSTACLE:
+			case KEY_CAL_EDGE: {
+				CALIB_TARGET_T target = ( c == KEY_CAL_OBSTACLE ) ?
+					CALIB_TARGET_OBSTACLE : CALIB_TARGET_EDGE;
+				cv::Rect region = cv::selectROI( "main", frame );
+				calibrator.add_region( frame, region, target );
+				cout << "Pixels: cones " << calibrator.pixels( CALIB_TARGET_OBSTACLE )
+					<< ", edges " << calibrator.pixels( CALIB_TARGET_EDGE ) << endl;
+				break;
+			}
+
+			case KEY_CAL_AUTO:
+				calibrator.add_auto( frame, m_nav.params );
+				for( int i = 1; i < CALIBRATE_AUTO_FRAMES; i++ ) {
+					//skip frames the camera didn't give us
+					cv::Mat sample = m_camera.get_frame();
+					if( sample.empty() )
+						continue;
+					calibrator.add_auto( sample, m_nav.params );
+				}
+				cout << "Pixels: cones " << calibrator.pixels( CALIB_TARGET_OBSTACLE )
+					<< ", edges " << calibrator.pixels( CALIB_TARGET_EDGE ) << endl;
+				break;
+
+			case KEY_CAL_APPLY:
+			case KEY_CAL_ENTER:
+				//params change now, the colour table catches up in the background
+				if( calibrator.apply( &m_nav.params ) )
+					m_nav.rebuild_classifier();
+				return;
+		}
+	}
+
+	cout << "Calibrate cancelled." << endl;
+}
+
+static double main_frame_time( const CAMERA_FRAME_T &frame )
+{
+	//recordings carry the time they were recorded at, not useful here
+	if( frame.image.empty() || m_camera.backend == CAMERA_BACKEND_RECORDING )
+		return Scheduler::now();
+	return frame.time;
 }
 
 static void main_report_nav(void)
@@ -0,0 +1,225 @@
+/****************************************************************************
+ * Navigate benchmark - Times Navigate on a recording (or generated frames)
+ *                      with classification spread over 1, 2, 4 and 8
+ *                      worker threads, and compares the route engines.
+ *
+ * Usage: nav_bench [-s WIDTHxHEIGHT] [-r repeats] [video.avi]
+ *
+ * Authors: James Swift, Luke Newmeyer
+ ****************************************************************************/
+
+/****************************** Include Files ******************************/
+// Standard includes
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// OpenCV includes
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+// Planner
+#include "Navigate.hpp"
+#include "Scheduler.hpp"
+
+/****************************** Definitions ********************************/
+
+/** Frames generated when no recording is given */
+#define BENCH_GENERATED_FRAMES 60
+/** Default number of times the frames are replayed per test */
+#define BENCH_DEFAULT_REPEATS 5
+
+using std::cout;
+using std::endl;
+using std::vector;
+using cv::Mat;
+using cv::Size;
+
+/****************************** Private Functions **************************/
+
+static bool bench_load( const char *filename, Size size, vector<Mat> *frames );
+static void bench_generate( Size size, vector<Mat> *frames );
+static bool bench_check_generated( const Mat &frame );
+static double bench_run( const vector<Mat> &frames, int workers,
+		NAV_ENGINE_T engine, int repeats, vector<int> *directions );
+
+/****************************** Implementation *****************************/
+
+int main( int argc, char **argv )
+{
+	Size size( 0, 0 );
+	int repeats = BENCH_DEFAULT_REPEATS;
+	int opt;
+
+	while( ( opt = getopt( argc, argv, "s:r:" ) ) != -1 ) {
+		switch( opt ) {
+			case 's':
+				if( sscanf( optarg, "%dx%d", &size.width, &size.height ) != 2 ) {
+					cout << "Size should look like 640x480" << endl;
+					return -1;
+				}
+				break;
+			case 'r':
+				repeats = atoi( optarg );
+				break;
+			default:
+				cout << "Usage: " << argv[0] << " [-s WIDTHxHEIGHT] [-r repeats] [video.avi]" << endl;
+				return -1;
+		}
+	}
+
+	//get frames (scaled to the requested size)
+	vector<Mat> frames;
+	if( optind < argc ) {
+		if( !bench_load( argv[optind], size, &frames ) )
+			return -1;
+	}
+	else {
+		if( size.width == 0 )
+			size = Size( 640, 480 );
+		bench_generate( size, &frames );
+		if( !bench_check_generated( frames.at(0) ) )
+			return -1;
+	}
+	if( frames.empty() ) {
+		cout << "Error: no frames" << endl;
+		return -1;
+	}
+	cout << frames.size() << " frames of " << frames.at(0).cols << "x"
+		<< frames.at(0).rows << ", " << repeats << " repeats" << endl;
+
+	//single thread first as the baseline
+	vector<int> greedyDirections;
+	double base = bench_run( frames, 0, NAV_ENGINE_GREEDY, repeats, &greedyDirections );
+	printf( "classify workers  ms/frame  speedup\n" );
+	printf( "  none (inline)   %8.3f  %6.2fx\n", base, 1.0 );
+	int workers[] = { 1, 2, 4, 8 };
+	for( int i = 0; i < 4; i++ ) {
+		double ms = bench_run( frames, workers[i], NAV_ENGINE_GREEDY, repeats, NULL );
+		printf( "  %d               %8.3f  %6.2fx\n", workers[i], ms, base / ms );
+	}
+
+	//compare the other engines against greedy (inline classification)
+	const char *names[] = { "greedy", "multi", "dp" };
+	printf( "engine  ms/frame  avg |direction - greedy|\n" );
+	printf( "  %-6s%8.3f  %6.2f\n", names[NAV_ENGINE_GREEDY], base, 0.0 );
+	for( int e = NAV_ENGINE_GREEDY + 1; e < NAV_ENGINE_NUMS; e++ ) {
+		vector<int> directions;
+		double ms = bench_run( frames, 0, (NAV_ENGINE_T)e, repeats, &directions );
+		double diff = 0;
+		for( int f = 0; f < (int)directions.size(); f++ )
+			diff += abs( directions.at(f) - greedyDirections.at(f) );
+		printf( "  %-6s%8.3f  %6.2f\n", names[e], ms, diff / directions.size() );
+	}
+
+	return 0;
+}
+
+static bool bench_load( const char *filename, Size size, vector<Mat> *frames )
+{
+	cv::VideoCapture video( filename );
+	if( !video.isOpened() ) {
+		cout << "Error: couldn't open " << filename << endl;
+		return false;
+	}
+
+	Mat frame;
+	while( video.read( frame ) && !frame.empty() ) {
+		if( size.width != 0 && frame.size() != size ) {
+			Mat scaled;
+			cv::resize( frame, scaled, size, 0, 0, cv::INTER_LINEAR );
+			frames->push_back( scaled );
+		}
+		else {
+			frames->push_back( frame.clone() );
+		}
+	}
+
+	return true;
+}
+
+//Gray noise with course edges down both sides and a cone. The planner runs
+//CV_RGB2HSV on BGR frames, so the colours here are picked for what that
+//makes of them: BGR blue reads as hue ~13 (the edge box) and BGR red as hue
+//120 (the obstacle box).
+static void bench_generate( Size size, vector<Mat> *frames )
+{
+	cv::RNG rng( 1 );
+	for( int f = 0; f < BENCH_GENERATED_FRAMES; f++ ) {
+		Mat frame( size, CV_8UC3 );
+		rng.fill( frame, cv::RNG::UNIFORM, cv::Scalar( 60, 60, 60 ), cv::Scalar( 140, 140, 140 ) );
+
+		//edges
+		int edgeW = size.width / 16;
+		int shift = ( f * size.width ) / ( 8 * BENCH_GENERATED_FRAMES );
+		cv::rectangle( frame, cv::Point( shift, 0 ), cv::Point( shift + edgeW, size.height - 1 ),
+				cv::Scalar( 230, 110, 20 ), -1 );
+		cv::rectangle( frame, cv::Point( size.width - 1 - edgeW, 0 ),
+				cv::Point( size.width - 1, size.height - 1 ), cv::Scalar( 230, 110, 20 ), -1 );
+
+		//cone
+		cv::circle( frame, cv::Point( size.width / 2 + shift, size.height / 3 ),
+				size.height / 10, cv::Scalar( 30, 30, 200 ), -1 );
+
+		frames->push_back( frame );
+	}
+}
+
+//Make sure the generated edges and cone classify as edges and obstacles
+//with the default boxes (area within half to one and a half times what was
+//drawn, the noise adds a few edge pixels)
+static bool bench_check_generated( const Mat &frame )
+{
+	NAV_PARAMS_T p = Navigate::default_params();
+	Mat hsv;
+	Mat obstacles;
+	Mat edges;
+	cv::cvtColor( frame, hsv, CV_RGB2HSV );
+	cv::inRange( hsv, cv::Scalar( p.obstacleHueCenter - p.obstacleHueRange, p.obstacleSatMin, p.obstacleValMin ),
+			cv::Scalar( p.obstacleHueCenter + p.obstacleHueRange, 255, p.obstacleValMax ), obstacles );
+	cv::inRange( hsv, cv::Scalar( p.edgeHueCenter - p.edgeHueRange, p.edgeSatMin, p.edgeValMin ),
+			cv::Scalar( p.edgeHueCenter + p.edgeHueRange, 255, p.edgeValMax ), edges );
+
+	int radius = frame.rows / 10;
+	double coneArea = 3.14159 * radius * radius;
+	double edgeArea = 2.0 * ( frame.cols / 16 + 1 ) * frame.rows;
+	int numObstacles = cv::countNonZero( obstacles );
+	int numEdges = cv::countNonZero( edges );
+	if( numObstacles < 0.5 * coneArea || numObstacles > 1.5 * coneArea ||
+			numEdges < 0.5 * edgeArea || numEdges > 1.5 * edgeArea ) {
+		cout << "Error: generated frame classifies as " << numObstacles << " obstacle pixels (cone is "
+			<< (int)coneArea << ") and " << numEdges << " edge pixels (edges are "
+			<< (int)edgeArea << ")" << endl;
+		return false;
+	}
+	return true;
+}
+
+//Average milliseconds per frame for analyze_frame. The direction picked for
+//each frame on the first pass is saved if directions isn't NULL.
+static double bench_run( const vector<Mat> &frames, int workers,
+		NAV_ENGINE_T engine, int repeats, vector<int> *directions )
+{
+	Navigate nav;
+	nav.verbose = false;
+	nav.routeEngine = engine;
+	nav.set_workers( workers, SCHED_CORE_ANY );
+
+	//warm up (allocations, tables)
+	nav.analyze_frame( frames.at(0) );
+
+	double start = Scheduler::now();
+	for( int r = 0; r < repeats; r++ ) {
+		for( int f = 0; f < (int)frames.size(); f++ ) {
+			nav.analyze_frame( frames.at(f) );
+			if( r == 0 && directions != NULL )
+				directions->push_back( nav.direction );
+		}
+	}
+	double seconds = Scheduler::now() - start;
+
+	return ( seconds * 1000.0 ) / ( repeats * frames.size() );
+}
@@ -0,0 +1,271 @@
+/****************************************************************************
+ * Parameter sweep - Replays recordings through Navigate under many planner
+ *                   parameter sets at once (one worker per core) and ranks
+ *                   them by how stable the resulting route is.
+ *
+ * Usage: param_sweep [-j workers] [-n top] video.avi [video.avi ...]
+ *
+ * Authors: James Swift, Luke Newmeyer
+ ****************************************************************************/
+
+/****************************** Include Files ******************************/
+// Standard includes
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+
+// OpenCV includes
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+// Planner
+#include "Navigate.hpp"
+
+/****************************** Definitions ********************************/
+
+/** How many of the best parameter sets to print */
+#define SWEEP_DEFAULT_TOP 10
+/** Score added each time the planner decides to bail (per 100 frames) */
+#define SWEEP_BAIL_PENALTY 20.0
+/** Routes shorter than this many rows count as short */
+#define SWEEP_SHORT_ROUTE 10
+/** Score added for the portion of frames with a short route */
+#define SWEEP_SHORT_PENALTY 50.0
+
+using std::cout;
+using std::endl;
+using std::vector;
+using cv::VideoCapture;
+using cv::Mat;
+
+/** One parameter that gets swept and the values it takes */
+typedef struct SWEEP_AXIS_S {
+	const char *name;
+	vector<double> values;
+	void (*set)(NAV_PARAMS_T *params, double value);
+} SWEEP_AXIS_T;
+
+/** Result of replaying every recording with one parameter set */
+typedef struct SWEEP_RESULT_S {
+	int index;          //parameter set number
+	double score;       //lower is better
+	double dirChange;   //average change in direction per frame
+	int bails;          //times the planner went into bail state
+	double shortRoutes; //portion of frames with a short route
+} SWEEP_RESULT_T;
+
+/****************************** Private Functions **************************/
+
+static vector<SWEEP_AXIS_T> sweep_axes( void );
+static NAV_PARAMS_T sweep_params( const vector<SWEEP_AXIS_T> &axes, int index );
+static bool sweep_load( const char *filename, vector<Mat> *frames );
+static SWEEP_RESULT_T sweep_run( const vector< vector<Mat> > &recordings,
+		const NAV_PARAMS_T &params );
+
+/****************************** Implementation *****************************/
+
+int main( int argc, char **argv )
+{
+	int workers = (int)std::thread::hardware_concurrency();
+	int top = SWEEP_DEFAULT_TOP;
+	int opt;
+
+	while( ( opt = getopt( argc, argv, "j:n:" ) ) != -1 ) {
+		switch( opt ) {
+			case 'j':
+				workers = atoi( optarg );
+				break;
+			case 'n':
+				top = atoi( optarg );
+				break;
+			default:
+				cout << "Usage: " << argv[0] << " [-j workers] [-n top] video.avi ..." << endl;
+				return -1;
+		}
+	}
+	if( optind >= argc ) {
+		cout << "Usage: " << argv[0] << " [-j workers] [-n top] video.avi ..." << endl;
+		return -1;
+	}
+	if( workers < 1 )
+		workers = 1;
+
+	//load every recording into memory once, workers share them read only
+	vector< vector<Mat> > recordings;
+	for( int i = optind; i < argc; i++ ) {
+		vector<Mat> frames;
+		if( !sweep_load( argv[i], &frames ) )
+			return -1;
+		cout << "Loaded " << frames.size() << " frames from " << argv[i] << endl;
+		recordings.push_back( frames );
+	}
+
+	//every combination of axis values is a parameter set
+	vector<SWEEP_AXIS_T> axes = sweep_axes();
+	int numSets = 1;
+	for( int a = 0; a < (int)axes.size(); a++ )
+		numSets *= (int)axes.at(a).values.size();
+	cout << "Sweeping " << numSets << " parameter sets on " << workers << " workers" << endl;
+
+	//workers pull the next parameter set until all are done
+	vector<SWEEP_RESULT_T> results( numSets );
+	std::atomic<int> next( 0 );
+	std::atomic<int> done( 0 );
+	vector<std::thread> threads;
+	int64 start = cv::getTickCount();
+	for( int w = 0; w < workers; w++ ) {
+		threads.push_back( std::thread( [&]() {
+			int index;
+			while( ( index = next++ ) < numSets ) {
+				results.at(index) = sweep_run( recordings, sweep_params( axes, index ) );
+				results.at(index).index = index;
+				int finished = ++done;
+				if( finished % 25 == 0 )
+					cout << "  " << finished << "/" << numSets << endl;
+			}
+		} ) );
+	}
+	for( int w = 0; w < workers; w++ )
+		threads.at(w).join();
+	double seconds = (double)( cv::getTickCount() - start ) / cv::getTickFrequency();
+	cout << "Done in " << seconds << " seconds" << endl;
+
+	//rank by score
+	std::sort( results.begin(), results.end(),
+		[]( const SWEEP_RESULT_T &a, const SWEEP_RESULT_T &b ) {
+			return a.score < b.score;
+		} );
+
+	//print the best parameter sets
+	if( top > numSets )
+		top = numSets;
+	for( int r = 0; r < top; r++ ) {
+		const SWEEP_RESULT_T &res = results.at(r);
+		printf( "%2d. score %7.2f  dir change %6.2f  bails %3d  short %4.2f |",
+				r + 1, res.score, res.dirChange, res.bails, res.shortRoutes );
+		int index = res.index;
+		for( int a = 0; a < (int)axes.size(); a++ ) {
+			int n = (int)axes.at(a).values.size();
+			printf( " %s=%g", axes.at(a).name, axes.at(a).values.at( index % n ) );
+			index /= n;
+		}
+		printf( "\n" );
+	}
+
+	return 0;
+}
+
+//Parameters that get swept. Add axes here, every combination is tried.
+static vector<SWEEP_AXIS_T> sweep_axes( void )
+{
+	vector<SWEEP_AXIS_T> axes;
+	SWEEP_AXIS_T axis;
+
+	axis.name = "steeringSensitivity";
+	axis.values = { 7.5, 9.5, 11.5 };
+	axis.set = []( NAV_PARAMS_T *p, double v ) { p->steeringSensitivity = (float)v; };
+	axes.push_back( axis );
+
+	axis.name = "expFactor";
+	axis.values = { 0.04, 0.06, 0.08 };
+	axis.set = []( NAV_PARAMS_T *p, double v ) { p->expFactor = (float)v; };
+	axes.push_back( axis );
+
+	axis.name = "objInRowMultiplier";
+	axis.values = { 1, 2, 3 };
+	axis.set = []( NAV_PARAMS_T *p, double v ) { p->objInRowMultiplier = (int)v; };
+	axes.push_back( axis );
+
+	axis.name = "bailDistanceFactor";
+	axis.values = { 0.3, 0.4, 0.5 };
+	axis.set = []( NAV_PARAMS_T *p, double v ) { p->bailDistanceFactor = (float)v; };
+	axes.push_back( axis );
+
+	axis.name = "obstacleSatMin";
+	axis.values = { 150, 175, 200 };
+	axis.set = []( NAV_PARAMS_T *p, double v ) { p->obstacleSatMin = (int)v; };
+	axes.push_back( axis );
+
+	axis.name = "edgeSatMin";
+	axis.values = { 80, 100, 120 };
+	axis.set = []( NAV_PARAMS_T *p, double v ) { p->edgeSatMin = (int)v; };
+	axes.push_back( axis );
+
+	return axes;
+}
+
+//Build parameter set number index (mixed radix over the axes)
+static NAV_PARAMS_T sweep_params( const vector<SWEEP_AXIS_T> &axes, int index )
+{
+	NAV_PARAMS_T params = Navigate::default_params();
+	for( int a = 0; a < (int)axes.size(); a++ ) {
+		int n = (int)axes.at(a).values.size();
+		axes.at(a).set( &params, axes.at(a).values.at( index % n ) );
+		index /= n;
+	}
+	return params;
+}
+
+static bool sweep_load( const char *filename, vector<Mat> *frames )
+{
+	VideoCapture video( filename );
+	if( !video.isOpened() ) {
+		cout << "Error: couldn't open " << filename << endl;
+		return false;
+	}
+
+	Mat frame;
+	while( video.read( frame ) && !frame.empty() )
+		frames->push_back( frame.clone() );
+
+	return true;
+}
+
+//Replay every recording with a fresh planner and score the route stability
+static SWEEP_RESULT_T sweep_run( const vector< vector<Mat> > &recordings,
+		const NAV_PARAMS_T &params )
+{
+	SWEEP_RESULT_T res;
+	double dirChange = 0;
+	int shortRoutes = 0;
+	int frames = 0;
+
+	res.bails = 0;
+	for( int r = 0; r < (int)recordings.size(); r++ ) {
+		Navigate nav( params );
+		nav.verbose = false;
+
+		int lastDirection = 0;
+		bool wasBailing = false;
+		for( int f = 0; f < (int)recordings.at(r).size(); f++ ) {
+			nav.analyze_frame( recordings.at(r).at(f) );
+
+			//count steering changes, new bails and short routes
+			if( f != 0 )
+				dirChange += abs( nav.direction - lastDirection );
+			lastDirection = nav.direction;
+			if( nav.is_bailing() && !wasBailing )
+				res.bails++;
+			wasBailing = nav.is_bailing();
+			if( !nav.is_bailing() && nav.planRowsTotal < SWEEP_SHORT_ROUTE )
+				shortRoutes++;
+			frames++;
+		}
+	}
+
+	if( frames == 0 )
+		frames = 1;
+	res.dirChange = dirChange / frames;
+	res.shortRoutes = (double)shortRoutes / frames;
+	res.score = res.dirChange +
+		SWEEP_BAIL_PENALTY * ( res.bails * 100.0 ) / frames +
+		SWEEP_SHORT_PENALTY * res.shortRoutes;
+
+	return res;
+}
@@ -0,0 +1,450 @@
+/****************************************************************************
+ * Tree trainer - Trains a small decision tree that labels pixels free,
+ *                course edge or obstacle from hand labelled frames, and
+ *                writes it out as C++ (autopilot/src/TreeClassifier.hpp)
+ *                that Navigate runs without branching on the pixel.
+ *
+ * Label images are the same size as their frame and painted with:
+ *   black - not labelled (ignored)
+ *   white - free
+ *   blue  - course edge (BGR 255,0,0)
+ *   red   - obstacle (BGR 0,0,255)
+ *
+ * Usage: tree_train [-d depth] [-o TreeClassifier.hpp] frame.png labels.png ...
+ *
+ * Authors: James Swift, Luke Newmeyer
+ ****************************************************************************/
+
+/****************************** Include Files ******************************/
+// Standard includes
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// OpenCV includes
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+// Planner (for the hand tuned HSV boxes we compare against)
+#include "Navigate.hpp"
+
+/****************************** Definitions ********************************/
+
+/** Default tree depth (2^depth leaves) */
+#define TRAIN_DEFAULT_DEPTH 5
+/** Deepest tree we'll write out */
+#define TRAIN_MAX_DEPTH 8
+/** Default output file */
+#define TRAIN_DEFAULT_OUTPUT "../autopilot/src/TreeClassifier.hpp"
+/** Most samples kept per class (labelled pixels are subsampled past this) */
+#define TRAIN_MAX_SAMPLES 200000
+/** Times each frame is classified when timing */
+#define TRAIN_BENCH_REPEATS 50
+
+/** Pixel classes (must match TreeClassifier.hpp) */
+#define CLASS_FREE 0
+#define CLASS_EDGE 1
+#define CLASS_OBSTACLE 2
+#define CLASS_NUMS 3
+
+/** Features: B, G, R, B-G, G-R, R-B (differences stand in for hue and
+ *  saturation without a colour conversion per pixel) */
+#define FEATURE_NUMS 6
+/** Feature values are offset by this to index histograms */
+#define FEATURE_OFFSET 255
+#define FEATURE_BINS 511
+
+using std::cout;
+using std::endl;
+using std::vector;
+using cv::Mat;
+
+/** One labelled pixel */
+typedef struct SAMPLE_S {
+	short f[FEATURE_NUMS];
+	unsigned char cls;
+} SAMPLE_T;
+
+/** Complete tree of a fixed depth, nodes stored breadth first */
+typedef struct TREE_S {
+	int depth;
+	vector<int> feature;    //feature each inner node splits on
+	vector<int> threshold;  //right child when feature > threshold
+	vector<int> leaf;       //class of each leaf
+} TREE_T;
+
+/****************************** Private Functions **************************/
+
+static bool train_load( const char *frameFile, const char *labelFile,
+		vector<SAMPLE_T> *samples, vector<Mat> *frames );
+static void train_features( const uchar *bgr, short *f );
+static void train_node( vector<SAMPLE_T> &samples, int begin, int end,
+		int node, int level, int parentClass, TREE_T *tree );
+static int train_majority( const vector<SAMPLE_T> &samples, int begin, int end,
+		int parentClass );
+static void train_classify( const TREE_T &tree, Mat frame, Mat *obstacles, Mat *edges );
+static bool train_write( const TREE_T &tree, const char *filename );
+static void train_report( const TREE_T &tree, const vector<SAMPLE_T> &samples );
+static void train_bench( const TREE_T &tree, const vector<Mat> &frames );
+
+/****************************** Implementation *****************************/
+
+int main( int argc, char **argv )
+{
+	int depth = TRAIN_DEFAULT_DEPTH;
+	const char *output = TRAIN_DEFAULT_OUTPUT;
+	int opt;
+
+	while( ( opt = getopt( argc, argv, "d:o:" ) ) != -1 ) {
+		switch( opt ) {
+			case 'd':
+				depth = atoi( optarg );
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			default:
+				cout << "Usage: " << argv[0] << " [-d depth] [-o output.hpp] frame.png labels.png ..." << endl;
+				return -1;
+		}
+	}
+	if( optind >= argc || ( argc - optind ) % 2 != 0 ) {
+		cout << "Usage: " << argv[0] << " [-d depth] [-o output.hpp] frame.png labels.png ..." << endl;
+		return -1;
+	}
+	if( depth < 1 )
+		depth = 1;
+	if( depth > TRAIN_MAX_DEPTH )
+		depth = TRAIN_MAX_DEPTH;
+
+	//collect labelled pixels from every frame
+	vector<SAMPLE_T> samples;
+	vector<Mat> frames;
+	for( int i = optind; i < argc; i += 2 ) {
+		if( !train_load( argv[i], argv[i + 1], &samples, &frames ) )
+			return -1;
+	}
+	cout << "Training on " << samples.size() << " pixels from " << frames.size()
+		<< " frames, depth " << depth << endl;
+	if( samples.empty() ) {
+		cout << "Error: no labelled pixels" << endl;
+		return -1;
+	}
+
+	//grow the tree
+	TREE_T tree;
+	tree.depth = depth;
+	tree.feature.assign( ( 1 << depth ) - 1, 0 );
+	tree.threshold.assign( ( 1 << depth ) - 1, FEATURE_OFFSET );
+	tree.leaf.assign( 1 << depth, CLASS_FREE );
+	train_node( samples, 0, (int)samples.size(), 0, 0, CLASS_FREE, &tree );
+
+	train_report( tree, samples );
+	train_bench( tree, frames );
+
+	if( !train_write( tree, output ) )
+		return -1;
+	cout << "Wrote " << output << endl;
+
+	return 0;
+}
+
+static bool train_load( const char *frameFile, const char *labelFile,
+		vector<SAMPLE_T> *samples, vector<Mat> *frames )
+{
+	Mat frame = cv::imread( frameFile, cv::IMREAD_COLOR );
+	Mat labels = cv::imread( labelFile, cv::IMREAD_COLOR );
+	if( frame.empty() || labels.empty() ) {
+		cout << "Error: couldn't read " << frameFile << " or " << labelFile << endl;
+		return false;
+	}
+	if( frame.size() != labels.size() ) {
+		cout << "Error: " << labelFile << " isn't the same size as its frame" << endl;
+		return false;
+	}
+	frames->push_back( frame );
+
+	int counts[CLASS_NUMS] = { 0, 0, 0 };
+	for( int y = 0; y < frame.rows; y++ ) {
+		const uchar *px = frame.ptr<uchar>( y );
+		const uchar *lab = labels.ptr<uchar>( y );
+		for( int x = 0; x < frame.cols; x++, px += 3, lab += 3 ) {
+			SAMPLE_T s;
+			//paint colours, allowing for a little antialiasing
+			if( lab[0] > 200 && lab[1] > 200 && lab[2] > 200 )
+				s.cls = CLASS_FREE;
+			else if( lab[0] > 200 && lab[1] < 50 && lab[2] < 50 )
+				s.cls = CLASS_EDGE;
+			else if( lab[0] < 50 && lab[1] < 50 && lab[2] > 200 )
+				s.cls = CLASS_OBSTACLE;
+			else
+				continue;
+
+			//every so many once a class has enough
+			counts[s.cls]++;
+			if( counts[s.cls] > TRAIN_MAX_SAMPLES && counts[s.cls] % 4 != 0 )
+				continue;
+			train_features( px, s.f );
+			samples->push_back( s );
+		}
+	}
+
+	cout << "Loaded " << frameFile << ": " << counts[CLASS_FREE] << " free, "
+		<< counts[CLASS_EDGE] << " edge, " << counts[CLASS_OBSTACLE] << " obstacle" << endl;
+	return true;
+}
+
+static void train_features( const uchar *bgr, short *f )
+{
+	f[0] = bgr[0];
+	f[1] = bgr[1];
+	f[2] = bgr[2];
+	f[3] = (short)( bgr[0] - bgr[1] );
+	f[4] = (short)( bgr[1] - bgr[2] );
+	f[5] = (short)( bgr[2] - bgr[0] );
+}
+
+//Pick the split with the lowest Gini impurity for samples begin to end,
+//partition them and recurse. Every node of the complete tree gets a split
+//(pure nodes send everything left) so the generated code never branches.
+//Leaves nothing reaches take the class of the closest node something did.
+static void train_node( vector<SAMPLE_T> &samples, int begin, int end,
+		int node, int level, int parentClass, TREE_T *tree )
+{
+	int majority = train_majority( samples, begin, end, parentClass );
+	if( level == tree->depth ) {
+		tree->leaf.at( node - ( ( 1 << tree->depth ) - 1 ) ) = majority;
+		return;
+	}
+
+	int total = end - begin;
+	int bestFeature = 0;
+	int bestThreshold = FEATURE_OFFSET;  //everything goes left
+	double bestImpurity = 1e30;
+
+	if( total > 0 ) {
+		vector<int> hist( FEATURE_BINS * CLASS_NUMS );
+		for( int f = 0; f < FEATURE_NUMS; f++ ) {
+			std::fill( hist.begin(), hist.end(), 0 );
+			int all[CLASS_NUMS] = { 0, 0, 0 };
+			for( int i = begin; i < end; i++ ) {
+				hist[( samples[i].f[f] + FEATURE_OFFSET ) * CLASS_NUMS + samples[i].cls]++;
+				all[samples[i].cls]++;
+			}
+
+			//walk the thresholds keeping counts on the left
+			int left[CLASS_NUMS] = { 0, 0, 0 };
+			int leftTotal = 0;
+			for( int b = 0; b < FEATURE_BINS - 1; b++ ) {
+				for( int c = 0; c < CLASS_NUMS; c++ ) {
+					left[c] += hist[b * CLASS_NUMS + c];
+					leftTotal += hist[b * CLASS_NUMS + c];
+				}
+				int rightTotal = total - leftTotal;
+				if( leftTotal == 0 || rightTotal == 0 )
+					continue;
+
+				double giniL = 1.0;
+				double giniR = 1.0;
+				for( int c = 0; c < CLASS_NUMS; c++ ) {
+					double pl = (double)left[c] / leftTotal;
+					double pr = (double)( all[c] - left[c] ) / rightTotal;
+					giniL -= pl * pl;
+					giniR -= pr * pr;
+				}
+				double impurity = giniL * leftTotal + giniR * rightTotal;
+				if( impurity < bestImpurity ) {
+					bestImpurity = impurity;
+					bestFeature = f;
+					bestThreshold = b - FEATURE_OFFSET;
+				}
+			}
+		}
+	}
+
+	tree->feature.at( node ) = bestFeature;
+	tree->threshold.at( node ) = bestThreshold;
+
+	//left side first
+	int mid = begin;
+	for( int i = begin; i < end; i++ ) {
+		if( samples[i].f[bestFeature] <= bestThreshold )
+			std::swap( samples[i], samples[mid++] );
+	}
+
+	train_node( samples, begin, mid, 2 * node + 1, level + 1, majority, tree );
+	train_node( samples, mid, end, 2 * node + 2, level + 1, majority, tree );
+}
+
+static int train_majority( const vector<SAMPLE_T> &samples, int begin, int end,
+		int parentClass )
+{
+	if( begin >= end )
+		return parentClass;
+
+	int counts[CLASS_NUMS] = { 0, 0, 0 };
+	for( int i = begin; i < end; i++ )
+		counts[samples[i].cls]++;
+
+	int best = CLASS_FREE;
+	for( int c = 0; c < CLASS_NUMS; c++ )
+		if( counts[c] > counts[best] )
+			best = c;
+	return best;
+}
+
+//Same evaluation the generated code does
+static void train_classify( const TREE_T &tree, Mat frame, Mat *obstacles, Mat *edges )
+{
+	obstacles->create( frame.size(), CV_8UC1 );
+	edges->create( frame.size(), CV_8UC1 );
+	int inner = ( 1 << tree.depth ) - 1;
+
+	for( int y = 0; y < frame.rows; y++ ) {
+		const uchar *px = frame.ptr<uchar>( y );
+		uchar *obs = obstacles->ptr<uchar>( y );
+		uchar *edge = edges->ptr<uchar>( y );
+		for( int x = 0; x < frame.cols; x++, px += 3 ) {
+			short f[FEATURE_NUMS];
+			train_features( px, f );
+			int n = 0;
+			for( int d = 0; d < tree.depth; d++ )
+				n = 2 * n + 1 + ( f[tree.feature[n]] > tree.threshold[n] );
+			int cls = tree.leaf[n - inner];
+			obs[x] = (uchar)-( cls == CLASS_OBSTACLE );
+			edge[x] = (uchar)-( cls == CLASS_EDGE );
+		}
+	}
+}
+
+//Confusion matrix on the training pixels
+static void train_report( const TREE_T &tree, const vector<SAMPLE_T> &samples )
+{
+	static const char *names[CLASS_NUMS] = { "free", "edge", "obstacle" };
+	long confusion[CLASS_NUMS][CLASS_NUMS] = { { 0 } };
+	long correct = 0;
+	int inner = ( 1 << tree.depth ) - 1;
+
+	for( int i = 0; i < (int)samples.size(); i++ ) {
+		int n = 0;
+		for( int d = 0; d < tree.depth; d++ )
+			n = 2 * n + 1 + ( samples[i].f[tree.feature[n]] > tree.threshold[n] );
+		int cls = tree.leaf[n - inner];
+		confusion[samples[i].cls][cls]++;
+		if( cls == samples[i].cls )
+			correct++;
+	}
+
+	printf( "Training accuracy: %.2f%%\n", 100.0 * correct / samples.size() );
+	printf( "%10s %10s %10s %10s\n", "label\\tree", names[0], names[1], names[2] );
+	for( int c = 0; c < CLASS_NUMS; c++ )
+		printf( "%10s %10ld %10ld %10ld\n", names[c],
+				confusion[c][0], confusion[c][1], confusion[c][2] );
+}
+
+//Time the tree against cvtColor + inRange with the hand tuned boxes
+static void train_bench( const TREE_T &tree, const vector<Mat> &frames )
+{
+	NAV_PARAMS_T p = Navigate::default_params();
+	Mat hsv;
+	Mat obstacles;
+	Mat edges;
+
+	int64 start = cv::getTickCount();
+	for( int r = 0; r < TRAIN_BENCH_REPEATS; r++ ) {
+		for( int i = 0; i < (int)frames.size(); i++ ) {
+			cv::cvtColor( frames[i], hsv, CV_RGB2HSV );
+			cv::inRange( hsv, cv::Scalar( p.obstacleHueCenter - p.obstacleHueRange,
+						p.obstacleSatMin, p.obstacleValMin ),
+					cv::Scalar( p.obstacleHueCenter + p.obstacleHueRange, 255,
+						p.obstacleValMax ), obstacles );
+			cv::inRange( hsv, cv::Scalar( p.edgeHueCenter - p.edgeHueRange,
+						p.edgeSatMin, p.edgeValMin ),
+					cv::Scalar( p.edgeHueCenter + p.edgeHueRange, 255, p.edgeValMax ), edges );
+		}
+	}
+	double hsvMs = (double)( cv::getTickCount() - start ) * 1000.0 / cv::getTickFrequency();
+
+	start = cv::getTickCount();
+	for( int r = 0; r < TRAIN_BENCH_REPEATS; r++ )
+		for( int i = 0; i < (int)frames.size(); i++ )
+			train_classify( tree, frames[i], &obstacles, &edges );
+	double treeMs = (double)( cv::getTickCount() - start ) * 1000.0 / cv::getTickFrequency();
+
+	int runs = TRAIN_BENCH_REPEATS * (int)frames.size();
+	printf( "HSV boxes: %.3f ms/frame\n", hsvMs / runs );
+	printf( "Tree     : %.3f ms/frame\n", treeMs / runs );
+}
+
+//Write the tree out as a header Navigate includes
+static bool train_write( const TREE_T &tree, const char *filename )
+{
+	FILE *out = fopen( filename, "w" );
+	if( out == NULL ) {
+		cout << "Error: couldn't write " << filename << endl;
+		return false;
+	}
+	int inner = ( 1 << tree.depth ) - 1;
+
+	fprintf( out, "/******************************************************************************\n" );
+	fprintf( out, " * Tree Classifier - Labels pixels free, course edge or obstacle with a\n" );
+	fprintf( out, " *                   decision tree. Generated by tree_train, don't edit by\n" );
+	fprintf( out, " *                   hand, train it again instead.\n" );
+	fprintf( out, " *\n" );
+	fprintf( out, " * Authors: James Swift, Luke Newmeyer\n" );
+	fprintf( out, " * Copyright 2017\n" );
+	fprintf( out, " *****************************************************************************/\n" );
+	fprintf( out, "#pragma once\n\n" );
+	fprintf( out, "/****************************** Include Files ********************************/\n\n" );
+	fprintf( out, "#include <opencv2/core.hpp>\n\n" );
+	fprintf( out, "/****************************** Definitions **********************************/\n\n" );
+	fprintf( out, "#define TREE_DEPTH %d\n", tree.depth );
+	fprintf( out, "#define TREE_FREE %d\n", CLASS_FREE );
+	fprintf( out, "#define TREE_EDGE %d\n", CLASS_EDGE );
+	fprintf( out, "#define TREE_OBSTACLE %d\n\n", CLASS_OBSTACLE );
+
+	fprintf( out, "//feature each node splits on: B, G, R, B-G, G-R, R-B\n" );
+	fprintf( out, "static const unsigned char TREE_FEATURE[%d] = {", inner );
+	for( int i = 0; i < inner; i++ )
+		fprintf( out, "%s%d", i ? ", " : " ", tree.feature[i] );
+	fprintf( out, " };\n" );
+	fprintf( out, "//go right when the feature is above this\n" );
+	fprintf( out, "static const short TREE_THRESHOLD[%d] = {", inner );
+	for( int i = 0; i < inner; i++ )
+		fprintf( out, "%s%d", i ? ", " : " ", tree.threshold[i] );
+	fprintf( out, " };\n" );
+	fprintf( out, "//class of each leaf\n" );
+	fprintf( out, "static const unsigned char TREE_LEAF[%d] = {", inner + 1 );
+	for( int i = 0; i <= inner; i++ )
+		fprintf( out, "%s%d", i ? ", " : " ", tree.leaf[i] );
+	fprintf( out, " };\n\n" );
+
+	fprintf( out, "/****************************** Implementation *******************************/\n\n" );
+	fprintf( out, "//Fill the obstacle and edge masks (which may be views into bigger masks)\n" );
+	fprintf( out, "static inline void tree_classify(cv::Mat frame, cv::Mat *frameObstacles, cv::Mat *frameEdges)\n" );
+	fprintf( out, "{\n" );
+	fprintf( out, "\tframeObstacles->create(frame.size(), CV_8UC1);\n" );
+	fprintf( out, "\tframeEdges->create(frame.size(), CV_8UC1);\n\n" );
+	fprintf( out, "\tfor (int y = 0; y < frame.rows; y++) {\n" );
+	fprintf( out, "\t\tconst uchar *px = frame.ptr<uchar>(y);\n" );
+	fprintf( out, "\t\tuchar *obs = frameObstacles->ptr<uchar>(y);\n" );
+	fprintf( out, "\t\tuchar *edge = frameEdges->ptr<uchar>(y);\n" );
+	fprintf( out, "\t\tfor (int x = 0; x < frame.cols; x++, px += 3) {\n" );
+	fprintf( out, "\t\t\tconst short f[6] = { px[0], px[1], px[2],\n" );
+	fprintf( out, "\t\t\t\t(short)(px[0] - px[1]), (short)(px[1] - px[2]), (short)(px[2] - px[0]) };\n" );
+	fprintf( out, "\t\t\tint n = 0;\n" );
+	for( int d = 0; d < tree.depth; d++ )
+		fprintf( out, "\t\t\tn = 2 * n + 1 + (f[TREE_FEATURE[n]] > TREE_THRESHOLD[n]);\n" );
+	fprintf( out, "\t\t\tint cls = TREE_LEAF[n - %d];\n", inner );
+	fprintf( out, "\t\t\tobs[x] = (uchar)-(cls == TREE_OBSTACLE);\n" );
+	fprintf( out, "\t\t\tedge[x] = (uchar)-(cls == TREE_EDGE);\n" );
+	fprintf( out, "\t\t}\n" );
+	fprintf( out, "\t}\n" );
+	fprintf( out, "}\n" );
+
+	fclose( out );
+	return true;
+}
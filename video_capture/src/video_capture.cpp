@@ -1,78 +1,245 @@
 /****************************************************************************
  * Video capture
+ *
+ * Owns the camera: every frame is published on the frame bus (so the
+ * autopilot and viewers can use it at the same time) and recorded, as MJPG
+ * or with -r as raw frames from a writer thread (Recorder).
+ * With -c the camera runs at a higher resolution than the planner's: the
+ * recording gets the full frames and the frame bus gets them shrunk to
+ * CAMERA_WIDTH x CAMERA_HEIGHT (FrameScaler), so one camera serves both.
+ * -c needs -r (or -n): MJPG is encoded on the capture loop, at full size it
+ * would hold up the planner's frames.
+ * With -w it is a viewer of another capture's frame bus instead, with -p
+ * it plays a raw recording.
  ****************************************************************************/
 
 /****************************** Include Files ******************************/
 // Standard includes
 #include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 // OpenCV includes
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+
+// Autopilot includes
+#include "Camera.hpp"
+#include "FrameBus.hpp"
+#include "Recorder.hpp"
+#include "Recording.hpp"
+#include "FrameScaler.hpp"
 
 /****************************** Definitions ********************************/
 
 #define VIDEO_TITLE "video_output.avi"
 #define VIDEO_RATE 30
+#define VIEW_TIMEOUT_MS 1000
 
 using std::cout;
 using std::endl;
-using cv::VideoCapture;
 using cv::VideoWriter;
 using cv::Mat;
 using cv::Size;
 using cv::waitKey;
 
+/****************************** Private Functions **************************/
+
+static void usage( const char *name )
+{
+	cout << "Usage: " << name << " [-c WxH] [-n] [-r dir] [-w] [-p dir [-s seconds]]" << endl;
+	cout << "  -c  capture (and record) at WxH, e.g. 640x360 (keep the planner's shape), needs -r or -n" << endl;
+	cout << "  -n  publish only, don't record" << endl;
+	cout << "  -r  record raw frames to dir instead of " << VIDEO_TITLE << endl;
+	cout << "  -w  watch the frame bus of a running capture" << endl;
+	cout << "  -p  play a raw recording, from -s seconds in" << endl;
+}
+
+//Show a frame whatever its format
+static void show( const CAMERA_FRAME_T &frame, Mat *bgr )
+{
+	if( frame.format == CAMERA_FORMAT_YUYV )
+		cvtColor( frame.image, *bgr, cv::COLOR_YUV2BGR_YUYV );
+	else
+		frame.image.copyTo( *bgr );
+	cv::imshow( "video_capture", *bgr );
+}
+
+//Show another capture's frames until space is pressed
+static int view( void )
+{
+	FrameBus bus;
+	if( !bus.attach( FRAME_BUS_NAME ) ) {
+		cout << "Error: no capture is publishing frames" << endl;
+		return -1;
+	}
+
+	cout << "Watching frames. Press space to stop." << endl;
+	CAMERA_FRAME_T frame;
+	Mat bgr;
+	while( waitKey(1) != ' ' && bus.acquire( &frame, VIEW_TIMEOUT_MS ) )
+		show( frame, &bgr );
+	return 0;
+}
+
+//Play a raw recording at the rate it was recorded, starting seconds in
+static int play( const char *dir, double seconds )
+{
+	Recording recording;
+	if( !recording.open( dir ) ) {
+		cout << "Error: could not open recording " << dir << endl;
+		return -1;
+	}
+
+	cout << "Playing " << recording.frames() << " frames. Press space to stop." << endl;
+	CAMERA_FRAME_T frame;
+	Mat bgr;
+	long index = recording.find( recording.start_time() + seconds );
+	double last = 0;
+	while( recording.frame( index++, &frame ) ) {
+		int waitMs = ( last == 0 ) ? 1 : (int)( ( frame.time - last ) * 1000.0 );
+		last = frame.time;
+		if( waitKey( waitMs > 0 ? waitMs : 1 ) == ' ' )
+			break;
+		show( frame, &bgr );
+	}
+	return 0;
+}
+
 /****************************** Implementation *****************************/
 
 int main( int argc, char **argv)
 {
+	bool record = true;
+	const char *rawDir = NULL;
+	const char *playDir = NULL;
+	double playFrom = 0;
+	int captureWidth = CAMERA_WIDTH;
+	int captureHeight = CAMERA_HEIGHT;
+	int opt;
+	while( ( opt = getopt( argc, argv, "c:nr:wp:s:" ) ) != -1 ) {
+		switch( opt ) {
+			case 'c':
+				if( sscanf( optarg, "%dx%d", &captureWidth, &captureHeight ) != 2 ) {
+					usage( argv[0] );
+					return -1;
+				}
+				break;
+			case 'n':
+				record = false;
+				break;
+			case 'r':
+				rawDir = optarg;
+				break;
+			case 'w':
+				return view();
+			case 'p':
+				playDir = optarg;
+				break;
+			case 's':
+				playFrom = atof( optarg );
+				break;
+			default:
+				usage( argv[0] );
+				return -1;
+		}
+	}
+	if( playDir != NULL )
+		return play( playDir, playFrom );
+
+	//full size MJPG encoding would stall publishing, only the raw recorder
+	//writes from its own thread
+	if( record && rawDir == NULL &&
+			( captureWidth != CAMERA_WIDTH || captureHeight != CAMERA_HEIGHT ) ) {
+		cout << "Error: -c records with -r (or use -n to only publish)" << endl;
+		usage( argv[0] );
+		return -1;
+	}
+
 	// Open camera and error and exit if failure to open
 	cout << "Opening camera..." << endl;
-	VideoCapture camera(0);
-	if (!camera.isOpened()) {
+	Camera camera;
+	camera.useBus = false;
+	camera.captureWidth = captureWidth;
+	camera.captureHeight = captureHeight;
+	camera.open();
+	CAMERA_FRAME_T frame;
+	if (!camera.grab( &frame )) {
 		cout << "Error: camera not open" << endl;
 		return -1;
 	}
-	//set resolution
-	camera.set(CV_CAP_PROP_FRAME_WIDTH, 160 );
-	camera.set(CV_CAP_PROP_FRAME_HEIGHT, 90 );
-
-	//camera.set(CV_CAP_PROP_FRAME_WIDTH, 320 );
-	//camera.set(CV_CAP_PROP_FRAME_HEIGHT, 240 );
 
-	//camera.set(CV_CAP_PROP_FRAME_WIDTH, 640 );
-	//camera.set(CV_CAP_PROP_FRAME_HEIGHT, 480 );
-
-	//camera.set(CV_CAP_PROP_FRAME_WIDTH, 1920 );
-	//camera.set(CV_CAP_PROP_FRAME_HEIGHT, 1080 );
+	//share frames with the autopilot, at the size it plans at
+	FrameScaler scaler;
+	CAMERA_FRAME_T planFrame;
+	scaler.scale( frame, &planFrame );
+	cout << "Recording " << frame.image.cols << "x" << frame.image.rows << ", publishing "
+		<< planFrame.image.cols << "x" << planFrame.image.rows << endl;
+	FrameBus bus;
+	if (!bus.create( FRAME_BUS_NAME, planFrame.image.cols, planFrame.image.rows, frame.format )) {
+		cout << "Error: could not publish frames" << endl;
+		return -1;
+	}
 
-	//create video writer
-	cout << "Opening video file..." << endl;
+	//create video writer (or raw recorder)
 	VideoWriter video;
-	Size image_size = Size((int)camera.get(CV_CAP_PROP_FRAME_WIDTH),
-			(int)camera.get(CV_CAP_PROP_FRAME_HEIGHT));
-	video.open(	VIDEO_TITLE, 
-			VideoWriter::fourcc('M', 'J', 'P', 'G'), 
-			VIDEO_RATE, 
-			image_size, 
-			true);
-	if (!video.isOpened())
-	{
-		cout << "Could not open video output" << endl;
-		return -1;
+	Recorder recorder;
+	if (record && rawDir != NULL) {
+		cout << "Opening recording " << rawDir << "..." << endl;
+		if (!recorder.open( rawDir, frame.image.cols, frame.image.rows, frame.format )) {
+			cout << "Could not open recording" << endl;
+			return -1;
+		}
+	}
+	else if (record) {
+		cout << "Opening video file..." << endl;
+		video.open(	VIDEO_TITLE, 
+				VideoWriter::fourcc('M', 'J', 'P', 'G'), 
+				VIDEO_RATE, 
+				frame.image.size(), 
+				true);
+		if (!video.isOpened())
+		{
+			cout << "Could not open video output" << endl;
+			return -1;
+		}
 	}
 
 	//capture video
 	cout << "Capturing video. Pres space to stop." << endl;
-	Mat frame;
-	while( waitKey(1) != ' ' ) {
+	Mat bgr;
+	while( waitKey(1) != ' ' && !frame.image.empty() ) {
+		//hand the (shrunk) frame to everyone listening
+		scaler.scale( frame, &planFrame );
+		bus.publish( planFrame.image, planFrame.time );
+		planFrame.lease.reset();
+
+		//place frame in video (the recorder copies it for its thread)
+		if (record && rawDir != NULL) {
+			recorder.push( frame );
+		}
+		else if (record) {
+			if( frame.format == CAMERA_FORMAT_YUYV ) {
+				cvtColor( frame.image, bgr, cv::COLOR_YUV2BGR_YUYV );
+				video << bgr;
+			}
+			else {
+				video << frame.image;
+			}
+		}
+
 		//capture a frame
-		camera >> frame;
-		//place frame in video
-		video << frame;
+		camera.grab( &frame );
 	}
 
 	//done
+	if (rawDir != NULL) {
+		recorder.close();
+		cout << "Frames recorded: " << recorder.framesWritten << ", dropped: "
+			<< recorder.framesDropped << endl;
+	}
+	bus.print_readers();
 	cout << "Done!\n";
 }